@@ -0,0 +1,311 @@
+/**
+ * BitSet.c
+ *
+ * Bit-vector implementation of a set of non-negative ints, with the
+ * same API as IntHashSet so that either can sit behind Set.h.
+ *
+ * Element i is bit (i % 64) of word (i / 64). The word array grows
+ * (and is zero-filled) when a larger element is inserted. Set
+ * operations work a whole word at a time, and iteration jumps from
+ * one set bit to the next with count-trailing-zeros.
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h> // used by toString()
+
+#include "BitSet.h"
+
+struct BitSet {
+	int nwords;
+	uint64_t* words;
+};
+
+/**
+ * Allocate and return a new empty BitSet with room for elements
+ * 0 to size-1 (it grows if larger elements are inserted).
+ */
+BitSet new_BitSet(int size) {
+	BitSet this = (BitSet)malloc(sizeof(struct BitSet));
+	if (this == NULL) {
+		return NULL;
+	}
+	this->nwords = size <= 0 ? 1 : (size + 63) / 64;
+	this->words = (uint64_t*)calloc(this->nwords, sizeof(uint64_t));
+	return this;
+}
+
+/**
+ * Free the given BitSet.
+ */
+void BitSet_free(BitSet this) {
+	if (this == NULL) {
+		return;
+	}
+	free(this->words);
+	free(this);
+}
+
+/**
+ * Make sure the given BitSet has at least nwords words.
+ */
+static void BitSet_reserve(BitSet this, int nwords) {
+	if (nwords <= this->nwords) {
+		return;
+	}
+	int n = this->nwords;
+	while (n < nwords) {
+		n *= 2;
+	}
+	this->words = (uint64_t*)realloc(this->words, n * sizeof(uint64_t));
+	memset(this->words + this->nwords, 0, (n - this->nwords) * sizeof(uint64_t));
+	this->nwords = n;
+}
+
+/**
+ * Insert the given element into the given BitSet if it isn't already
+ * present.
+ */
+void BitSet_insert(BitSet this, int element) {
+	BitSet_reserve(this, element / 64 + 1);
+	this->words[element / 64] |= (uint64_t)1 << (element % 64);
+}
+
+/**
+ * Return true if the given element is in the given BitSet,
+ * otherwise false.
+ */
+bool BitSet_lookup(BitSet this, int element) {
+	if (element < 0 || element / 64 >= this->nwords) {
+		return false;
+	}
+	return (this->words[element / 64] >> (element % 64)) & 1;
+}
+
+/**
+ * Add the contents of another BitSet to the given BitSet.
+ */
+void BitSet_union(BitSet this, const BitSet other) {
+	// Trailing zero words in other don't need any room in this
+	int n = other->nwords;
+	while (n > 0 && other->words[n-1] == 0) {
+		n--;
+	}
+	BitSet_reserve(this, n);
+	for (int i=0; i < n; i++) {
+		this->words[i] |= other->words[i];
+	}
+}
+
+/**
+ * Print the given BitSet to stdout.
+ */
+void BitSet_print(BitSet this) {
+	printf("{");
+	bool first = true;
+	for (int i=0; i < this->nwords; i++) {
+		for (uint64_t w=this->words[i]; w != 0; w &= w - 1) {
+			printf(first ? "%d" : ",%d", i * 64 + BitSet_lowest(w));
+			first = false;
+		}
+	}
+	printf("}");
+}
+
+/**
+ * Return the number of elements (ints) in the given BitSet.
+ */
+int BitSet_count(BitSet this) {
+	int count = 0;
+	for (int i=0; i < this->nwords; i++) {
+		count += BitSet_popcount(this->words[i]);
+	}
+	return count;
+}
+
+/**
+ * Return true if this BitSet is empty (contains no elements).
+ */
+bool BitSet_isEmpty(BitSet this) {
+	for (int i=0; i < this->nwords; i++) {
+		if (this->words[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return true if the two given BitSets contain exactly the
+ * same elements (ints), otherwise false. The sets may have grown to
+ * different lengths, in which case the extra words must be empty.
+ */
+bool BitSet_equals(BitSet this, BitSet other) {
+	BitSet shorter = this->nwords <= other->nwords ? this : other;
+	BitSet longer = shorter == this ? other : this;
+	for (int i=0; i < shorter->nwords; i++) {
+		if (this->words[i] != other->words[i]) {
+			return false;
+		}
+	}
+	for (int i=shorter->nwords; i < longer->nwords; i++) {
+		if (longer->words[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Call the given function on each element of the given
+ * BitSet, in increasing order.
+ */
+void BitSet_iterate(const BitSet this, void (*func)(int)) {
+	for (int i=0; i < this->nwords; i++) {
+		for (uint64_t w=this->words[i]; w != 0; w &= w - 1) {
+			func(i * 64 + BitSet_lowest(w));
+		}
+	}
+}
+
+/**
+ * A BitSetIterator iterates over the elements (ints) in a BitSet
+ * in increasing order.
+ */
+struct BitSetIterator {
+	BitSet set;
+	int index;		// word
+	uint64_t remaining;	// Bits of that word not yet returned
+};
+
+/**
+ * Return a BitSetIterator for the given BitSet.
+ * Don't forget to free() this when you're done iterating.
+ */
+BitSetIterator BitSet_iterator(const BitSet this) {
+	BitSetIterator iterator = (BitSetIterator)malloc(sizeof(struct BitSetIterator));
+	iterator->set = this;
+	iterator->index = 0;
+	iterator->remaining = this->words[0];
+	return iterator;
+}
+
+/**
+ * Return true if the next call to BitSetIterator_next on the given
+ * BitSetIterator will not fail.
+ */
+bool BitSetIterator_hasNext(const BitSetIterator this) {
+	// Skip over empty words so that next() finds a bit immediately
+	while (this->remaining == 0) {
+		if (this->index + 1 >= this->set->nwords) {
+			return false;
+		}
+		this->index += 1;
+		this->remaining = this->set->words[this->index];
+	}
+	return true;
+}
+
+/**
+ * Return the next int in the BitSet underlying the given
+ * BitSetIterator, or -1 if there is no such element.
+ */
+int BitSetIterator_next(BitSetIterator this) {
+	if (!BitSetIterator_hasNext(this)) {
+		return -1;
+	}
+	int element = this->index * 64 + BitSet_lowest(this->remaining);
+	this->remaining &= this->remaining - 1;
+	return element;
+}
+
+/**
+ * Return the string representation of the given BitSet, or NULL
+ * if it is empty (like IntHashSet_toString).
+ * Don't forget to free() this string.
+ */
+char* BitSet_toString(BitSet this) {
+	int count = BitSet_count(this);
+	if (count == 0) {
+		return NULL;
+	}
+	// At most 11 characters per int plus a comma
+	char *result = (char*)malloc(count * 12 + 1);
+	char *p = result;
+	for (int i=0; i < this->nwords; i++) {
+		for (uint64_t w=this->words[i]; w != 0; w &= w - 1) {
+			p += sprintf(p, p == result ? "%d" : ",%d", i * 64 + BitSet_lowest(w));
+		}
+	}
+	return result;
+}
+
+#ifdef MAIN
+
+static void callback(int element) {
+	printf("callback: %d\n", element);
+}
+
+int main(int argc, char* argv[]) {
+	printf("creating set with size 7...\n");
+	BitSet set1 = new_BitSet(7);
+	printf("testing insert...\n");
+	BitSet_insert(set1, 0);
+	BitSet_insert(set1, 1);
+	BitSet_insert(set1, 2);
+	BitSet_print(set1);
+	printf("\n");
+	printf("testing insert existing elements...\n");
+	BitSet_insert(set1, 0);
+	BitSet_insert(set1, 2);
+	BitSet_print(set1);
+	printf("\n");
+	printf("testing insert to force growth...\n");
+	BitSet_insert(set1, 63);
+	BitSet_insert(set1, 64);
+	BitSet_insert(set1, 200);
+	BitSet_print(set1);
+	printf("\n");
+	printf("testing lookup...\n");
+	printf("lookup 0: %d\n", BitSet_lookup(set1, 0));
+	printf("lookup 3: %d\n", BitSet_lookup(set1, 3));
+	printf("lookup 64: %d\n", BitSet_lookup(set1, 64));
+	printf("lookup 1000: %d\n", BitSet_lookup(set1, 1000));
+	printf("count: %d\n", BitSet_count(set1));
+	printf("testing iterate...\n");
+	BitSet_iterate(set1, callback);
+	printf("testing iterator...\n");
+	BitSetIterator iterator = BitSet_iterator(set1);
+	while (BitSetIterator_hasNext(iterator)) {
+		int element = BitSetIterator_next(iterator);
+		printf("%d ", element);
+	}
+	printf("\n");
+	free(iterator);
+	printf("creating new set with size 5...\n");
+	BitSet set2 = new_BitSet(5);
+	BitSet_insert(set2, 0);
+	BitSet_insert(set2, 1);
+	BitSet_insert(set2, 2);
+	printf("set1 equals set2? %d\n", BitSet_equals(set1, set2));
+	BitSet_insert(set2, 63);
+	BitSet_insert(set2, 64);
+	BitSet_insert(set2, 200);
+	printf("set1 equals set2? %d\n", BitSet_equals(set1, set2));
+	printf("set2 equals set1? %d\n", BitSet_equals(set2, set1));
+	printf("testing union...\n");
+	BitSet set3 = new_BitSet(1);
+	BitSet_union(set3, set1);
+	printf("set3 equals set1? %d\n", BitSet_equals(set3, set1));
+	printf("testing toString...\n");
+	char *s1 = BitSet_toString(set1);
+	printf("s1=\"%s\"\n", s1);
+	free(s1);
+	printf("freeing sets\n");
+	BitSet_free(set1);
+	BitSet_free(set2);
+	BitSet_free(set3);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * Bit-vector implementation of a set of non-negative ints.
+ * The set grows to hold whatever elements are inserted, so unlike a
+ * single machine word it is not limited to 63 (or 31) elements.
+ * It is the right representation for sets of automaton states, which
+ * are small, dense integers.
+ */
+
+#ifndef _BitSet_h
+#define _BitSet_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct BitSet* BitSet;
+
+extern BitSet new_BitSet(int size);
+extern void BitSet_free(BitSet this);
+extern void BitSet_insert(BitSet this, int i);
+extern bool BitSet_lookup(BitSet this, int i);
+extern void BitSet_union(BitSet this, const BitSet other);
+extern void BitSet_print(BitSet this);
+extern int BitSet_count(BitSet this);
+extern bool BitSet_isEmpty(BitSet this);
+extern bool BitSet_equals(BitSet this, BitSet other);
+extern void BitSet_iterate(const BitSet this, void (*func)(int));
+
+typedef struct BitSetIterator* BitSetIterator;
+
+extern BitSetIterator BitSet_iterator(const BitSet this);
+extern bool BitSetIterator_hasNext(const BitSetIterator this);
+extern int BitSetIterator_next(BitSetIterator this);
+
+extern char* BitSet_toString(BitSet this);
+
+/**
+ * Return the index of the lowest set bit of the given non-zero word.
+ */
+static inline int BitSet_lowest(uint64_t word) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	int i = 0;
+	while ((word & 1) == 0) {
+		word >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/**
+ * Return the number of set bits in the given word.
+ */
+static inline int BitSet_popcount(uint64_t word) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	int n = 0;
+	for (; word != 0; word &= word - 1) {
+		n++;
+	}
+	return n;
+#endif
+}
+
+#endif
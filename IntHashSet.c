@@ -5,53 +5,59 @@
  * Hashtable implementation of a set of ints.
  * @see FOCS pp. 360-363, 415
  *
- * This is a weak example of a set implementation.
- * It doesn't do anything smart about set operations other
- * than making it easy to add an element (int) to the set.
- * And it isn't very smart about that either, to be honest.
- *
- * YOU could probably do better...
+ * The table uses open addressing with linear probing: the elements
+ * live directly in one array of slots (a power of two in length), so
+ * inserting never allocates a node, and the array is doubled whenever
+ * it gets more than three-quarters full. INT_MIN marks an empty slot
+ * and so can't itself be stored in the set.
  */
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h> // used by toString()
 
 #include "IntHashSet.h"
 
-struct Node {
-	int element;
-	struct Node* next;
-};
-typedef struct Node Node;
+#define EMPTY INT_MIN
 
 struct IntHashSet {
-	int size;
-	Node** buckets; // Array of pointers to first node in list for bucket
+	int size;	// Number of slots (a power of 2)
+	int shift;	// 32 - log2(size), for the hash function
+	int* slots;	// Elements, or EMPTY
 	int count;
 };
 
-static Node* new_Node(int element) {
-	Node* this = (Node*)malloc(sizeof(struct Node));
-	this->element = element;
-	this->next = NULL;
-	return this;
+/**
+ * Allocate the slot array for the given IntHashSet, with room for at
+ * least the given number of elements before it needs to grow.
+ */
+static void IntHashSet_allocate(IntHashSet this, int elements) {
+	int size = 4;
+	int shift = 30;
+	while (size - size / 4 < elements) {
+		size *= 2;
+		shift -= 1;
+	}
+	this->size = size;
+	this->shift = shift;
+	this->slots = (int*)malloc(size * sizeof(int));
+	for (int i=0; i < size; i++) {
+		this->slots[i] = EMPTY;
+	}
 }
 
 /**
- * Allocate and return a new empty IntHashSet.
+ * Allocate and return a new empty IntHashSet with room for
+ * the given number of elements (it grows if more are added).
  */
 IntHashSet new_IntHashSet(int size) {
 	IntHashSet this = (IntHashSet)malloc(sizeof(struct IntHashSet));
 	if (this == NULL) {
 		return NULL;
 	}
-	this->size = size;
-	this->buckets = (Node**)calloc(size, sizeof(Node*));
-	for (int i=0; i < size; i++) {
-		this->buckets[i] = NULL;
-	}
+	IntHashSet_allocate(this, size);
 	this->count = 0;
 	return this;
 }
@@ -63,54 +69,51 @@ void IntHashSet_free(IntHashSet this) {
 	if (this == NULL) {
 		return;
 	}
-	// Free all the nodes
-	for (int index=0; index < this->size; index++) {
-		Node* p = this->buckets[index];
-		while (p != NULL) {
-			Node* next = p->next;
-			free(p);
-			p = next;
-		}
-	}
-	// Free the hashtable (array of bucket list headers) itself
-	free(this->buckets);
-	// Free the struct
+	free(this->slots);
 	free(this);
 }
 
 /**
- * Very simple hash function for IntHashSet.
- * @see FOCS p415.
+ * Fibonacci (multiplicative) hash function for IntHashSet: the top bits
+ * of element * 2^32/phi, which spreads runs of consecutive ints (like
+ * state numbers) evenly across the table.
+ * @see FOCS p415 for the simpler modulo version.
  */
 static int IntHashSet_hash(IntHashSet this, int element) {
-	int index = element % this->size;
+	return (int)(((uint32_t)element * 2654435769u) >> this->shift);
+}
+
+/**
+ * Return the slot holding the given element, or the empty slot
+ * where it would go.
+ */
+static int IntHashSet_find(IntHashSet this, int element) {
+	int mask = this->size - 1;
+	int index = IntHashSet_hash(this, element);
+	while (this->slots[index] != EMPTY && this->slots[index] != element) {
+		index = (index + 1) & mask;
+	}
 	return index;
 }
 
 /**
- * Insert the given element (int) into the Node list
- * pointed to by pL. That is, pL is the address of a Node.
- * If that address contains NULL, then this is the place
- * to add the element, so fill that address with a new Node.
- * Otherwise, pL points to a Node. If that Node's element
- * is the same as i, then i is already in the set and there
- * is nothing to do. Otherwise, try the next node in the list.
- * @see FOCS Fig 7.14 p. 365
- * We return true if the element was added or false if it was
- * already there, to support keeping track of the count of elements.
+ * Make sure the given IntHashSet can hold the given number of elements
+ * without exceeding its load factor, rehashing into a larger slot
+ * array if necessary.
  */
-static bool IntHashSet_bucketInsert(int element, Node** pL) {
-	if ((*pL) == NULL) {
-		// Not found in bucket: append
-		(*pL) = new_Node(element);
-		return true; // Yes added
-	} else if ((*pL)->element == element) {
-		// Found in bucket
-		return false; // Not added
-	} else {
-		// Keep searching bucket
-		return IntHashSet_bucketInsert(element, &((*pL)->next));
+static void IntHashSet_reserve(IntHashSet this, int elements) {
+	if (elements <= this->size - this->size / 4) {
+		return;
 	}
+	int* old = this->slots;
+	int oldSize = this->size;
+	IntHashSet_allocate(this, elements);
+	for (int i=0; i < oldSize; i++) {
+		if (old[i] != EMPTY) {
+			this->slots[IntHashSet_find(this, old[i])] = old[i];
+		}
+	}
+	free(old);
 }
 
 /**
@@ -118,35 +121,24 @@ static bool IntHashSet_bucketInsert(int element, Node** pL) {
  * it isn't already present.
  */
 void IntHashSet_insert(IntHashSet this, int element) {
-	int index = IntHashSet_hash(this, element);
-	if (IntHashSet_bucketInsert(element, &(this->buckets[index]))) {
-		this->count += 1;
+	int index = IntHashSet_find(this, element);
+	if (this->slots[index] == element) {
+		return;
+	}
+	if (this->count + 1 > this->size - this->size / 4) {
+		IntHashSet_reserve(this, this->count + 1);
+		index = IntHashSet_find(this, element);
 	}
+	this->slots[index] = element;
+	this->count += 1;
 }
 
-//void IntHashSet_insert_set(IntHashSet this, IntHashSet set) {
-//    // Iterate over the elements of `set` and insert them into `this`
-//    IntHashSetIterator iterator = IntHashSet_iterator(set);
-//    while (IntHashSetIterator_hasNext(iterator)) {
-//        int element = IntHashSetIterator_next(iterator);
-//        IntHashSet_insert(this, element);
-//    }
-//    free(iterator);
-//}
-
-
 /**
  * Return true if the given element is in the given IntHashSet,
  * otherwise false.
  */
 bool IntHashSet_lookup(IntHashSet this, int element) {
-	int index = IntHashSet_hash(this, element);
-	for (Node* p=this->buckets[index]; p != NULL; p=p->next) {
-		if (p->element == element) {
-			return true;
-		}
-	}
-	return false;
+	return this->slots[IntHashSet_find(this, element)] == element && element != EMPTY;
 }
 
 /**
@@ -156,24 +148,28 @@ bool IntHashSet_lookup(IntHashSet this, int element) {
  * all its elements are already in the first set.
  */
 void IntHashSet_union(IntHashSet this, const IntHashSet other) {
-	// Iterate over elements of other set, adding to this set
+	if (other->count == 0) {
+		return;
+	}
+	// Grow once up front rather than repeatedly while inserting
+	IntHashSet_reserve(this, this->count + other->count);
 	for (int index=0; index < other->size; index++) {
-		for (Node* p=other->buckets[index]; p != NULL; p=p->next) {
-			int element = p->element;
+		int element = other->slots[index];
+		if (element != EMPTY) {
 			IntHashSet_insert(this, element);
 		}
 	}
 }
 
-/**a
+/**
  * Print the given IntHashSet to stdout.
  */
 void IntHashSet_print(IntHashSet this) {
 	printf("{");
 	int n = 0;
 	for (int index=0; index < this->size; index++) {
-		for (Node* p=this->buckets[index]; p != NULL; p=p->next) {
-			int element = p->element;
+		int element = this->slots[index];
+		if (element != EMPTY) {
 			printf("%d", element);
 			n += 1;
 			if (n < this->count) {
@@ -210,13 +206,10 @@ bool IntHashSet_equals(IntHashSet this, IntHashSet other) {
 		return false;
 	}
 	// Otherwise have to scan and test each element
-	// You might be able to figure out which is better to scan over...
 	for (int index=0; index < this->size; index++) {
-		for (Node* p=this->buckets[index]; p != NULL; p=p->next) {
-			int element = p->element;
-			if (!IntHashSet_lookup(other, element)) {
-				return false;
-			}
+		int element = this->slots[index];
+		if (element != EMPTY && !IntHashSet_lookup(other, element)) {
+			return false;
 		}
 	}
 	return true;
@@ -229,8 +222,8 @@ bool IntHashSet_equals(IntHashSet this, IntHashSet other) {
  */
 void IntHashSet_iterate(const IntHashSet this, void (*func)(int)) {
 	for (int index=0; index < this->size; index++) {
-		for (Node* p=this->buckets[index]; p != NULL; p=p->next) {
-			int element = p->element;
+		int element = this->slots[index];
+		if (element != EMPTY) {
 			func(element);
 		}
 	}
@@ -243,8 +236,7 @@ void IntHashSet_iterate(const IntHashSet this, void (*func)(int)) {
 struct IntHashSetIterator {
 	IntHashSet set;
 	int count;
-	int index;	// bucket
-	Node *node;	// Node within bucket
+	int index;	// slot
 };
 
 /**
@@ -256,7 +248,6 @@ IntHashSetIterator IntHashSet_iterator(const IntHashSet this) {
 	iterator->set = this;
 	iterator->count = 0;
 	iterator->index = 0;
-	iterator->node = this->buckets[0];
 	return iterator;
 }
 
@@ -268,33 +259,22 @@ bool IntHashSetIterator_hasNext(const IntHashSetIterator this) {
 	return this->count < this->set->count;
 }
 
-/**
- * Return the next int in the IntHashSet underlying the given
- * IntHashSetIterator, or -1 if there is no such element (even though
- * -1 could be a value in an IntHashSet).
- */
 /**
  * Return the next int in the IntHashSet underlying the given
  * IntHashSetIterator, or -1 if there is no such element (even though
  * -1 could be a value in an IntHashSet).
  */
 int IntHashSetIterator_next(IntHashSetIterator this) {
-    while (this->node == NULL) {
-        if (this->index >= this->set->size) {
-            // Not found!
-            return -1;
-        }
-        if (this->index + 1 >= this->set->size) {
-            // After incrementing the index, check if it's still within bounds
-            return -1;
-        }
-        this->index += 1;
-        this->node = this->set->buckets[this->index];
-    }
-    int element = this->node->element;
-    this->node = this->node->next;
-    this->count += 1;
-    return element;
+	while (this->index < this->set->size) {
+		int element = this->set->slots[this->index];
+		this->index += 1;
+		if (element != EMPTY) {
+			this->count += 1;
+			return element;
+		}
+	}
+	// Not found!
+	return -1;
 }
 
 
@@ -350,12 +330,12 @@ int main(int argc, char* argv[]) {
 	IntHashSet_insert(set1, 2);
 	IntHashSet_print(set1);
 	printf("\n");
-	printf("testing insert to force overflow...\n");
+	printf("testing insert to force resize...\n");
 	IntHashSet_insert(set1, 3);
 	IntHashSet_insert(set1, 4);
 	IntHashSet_insert(set1, 5);
 	IntHashSet_insert(set1, 6);
-	IntHashSet_insert(set1, 7); // index 0: 0,7,1,2,3,4,5,6
+	IntHashSet_insert(set1, 7);
 	IntHashSet_print(set1);
 	printf("\n");
 	printf("testing lookup...\n");
@@ -385,9 +365,9 @@ int main(int argc, char* argv[]) {
 	printf("set2 equals set1? %d\n", IntHashSet_equals(set2, set1));
 	IntHashSet_insert(set2, 3);
 	IntHashSet_insert(set2, 4);
-	IntHashSet_insert(set2, 5); // index 0
-	IntHashSet_insert(set2, 6); // index 1
-	IntHashSet_insert(set2, 7); // index 2
+	IntHashSet_insert(set2, 5);
+	IntHashSet_insert(set2, 6);
+	IntHashSet_insert(set2, 7);
 	IntHashSet_print(set2);
 	printf("\n");
 	printf("set1 equals set2? %d\n", IntHashSet_equals(set1, set2));
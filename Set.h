@@ -2,11 +2,16 @@
  * Definitions of the Set type and functions to use either
  * IntHashSet (based on the code in FOCS) or the bit-vector
  * implementation BitSet.
- * Note that the latter will only work if you don't need to
- * store int values greater than 63 (31 on some platforms)
- * in your Sets.
+ * BitSet grows to fit its largest element, so it works for any
+ * number of states, and it is the better choice when the elements
+ * are small dense ints (like automaton states).
+ * Define USE_BITSET here or on the command line (-DUSE_BITSET,
+ * or cmake -DUSE_BITSET=ON) to select it.
  */
 
+#ifndef _Set_h
+#define _Set_h
+
 //#define USE_BITSET
 
 #ifndef USE_BITSET
@@ -16,10 +21,13 @@
 # define Set_free IntHashSet_free
 # define Set_isEmpty IntHashSet_isEmpty
 # define Set_insert IntHashSet_insert
+# define Set_lookup IntHashSet_lookup
+# define Set_count IntHashSet_count
 # define Set_union IntHashSet_union
 # define Set_equals IntHashSet_equals
 # define Set_print IntHashSet_print
 # define Set_toString IntHashSet_toString
+# define Set_iterate IntHashSet_iterate
 # define SetIterator IntHashSetIterator
 # define Set_iterator IntHashSet_iterator
 # define SetIterator_hasNext IntHashSetIterator_hasNext
@@ -27,16 +35,21 @@
 #else
 # include "BitSet.h"
 # define Set BitSet
-# define new_Set(N) new_BitSet()
+# define new_Set(N) new_BitSet(N)
 # define Set_free BitSet_free
 # define Set_isEmpty BitSet_isEmpty
 # define Set_insert BitSet_insert
+# define Set_lookup BitSet_lookup
+# define Set_count BitSet_count
 # define Set_union BitSet_union
 # define Set_equals BitSet_equals
 # define Set_print BitSet_print
 # define Set_toString BitSet_toString
+# define Set_iterate BitSet_iterate
 # define SetIterator BitSetIterator
 # define Set_iterator BitSet_iterator
 # define SetIterator_hasNext BitSetIterator_hasNext
 # define SetIterator_next BitSetIterator_next
 #endif
+
+#endif
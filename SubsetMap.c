@@ -0,0 +1,183 @@
+//
+// File: SubsetMap.c
+// Created: 10/17/2026
+//
+// Open-addressing hash table from subsets of NFA states to dense ids.
+// Subsets are stored once, back to back, in a single pool of ints; the
+// table itself only holds ids, so growing it never moves a subset.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "SubsetMap.h"
+
+struct SubsetMap {
+    int* slots;         // Subset id in each slot, or -1 if empty (capacity is a power of 2)
+    int capacity;
+    int* offsets;       // Start of each subset in the pool, by id
+    int* lengths;       // Number of states in each subset, by id
+    uint32_t* hashes;   // Cached hash of each subset, by id
+    int count;
+    int maxCount;
+    int* pool;
+    int poolSize;
+    int poolCapacity;
+    SubsetMapStats stats;
+};
+
+SubsetMap new_SubsetMap(int size) {
+    SubsetMap this = (SubsetMap)malloc(sizeof(struct SubsetMap));
+    if (this == NULL) {
+        return NULL;
+    }
+    int capacity = 16;
+    while (capacity < 2 * size) {
+        capacity *= 2;
+    }
+    this->capacity = capacity;
+    this->slots = (int*)malloc(capacity * sizeof(int));
+    memset(this->slots, -1, capacity * sizeof(int));
+    this->count = 0;
+    this->maxCount = capacity / 2;
+    this->offsets = (int*)malloc(this->maxCount * sizeof(int));
+    this->lengths = (int*)malloc(this->maxCount * sizeof(int));
+    this->hashes = (uint32_t*)malloc(this->maxCount * sizeof(uint32_t));
+    this->poolSize = 0;
+    this->poolCapacity = 64;
+    this->pool = (int*)malloc(this->poolCapacity * sizeof(int));
+    memset(&this->stats, 0, sizeof(this->stats));
+    return this;
+}
+
+void SubsetMap_free(SubsetMap this) {
+    if (this == NULL) {
+        return;
+    }
+    free(this->slots);
+    free(this->offsets);
+    free(this->lengths);
+    free(this->hashes);
+    free(this->pool);
+    free(this);
+}
+
+// FNV-1a over the state ids, followed by a final avalanche so that the low
+// bits used to pick a slot depend on every state in the subset.
+static uint32_t SubsetMap_hash(const int* states, int n) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        h = (h ^ (uint32_t)states[i]) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+static bool SubsetMap_matches(SubsetMap this, int id, uint32_t hash, const int* states, int n) {
+    return this->hashes[id] == hash && this->lengths[id] == n
+        && memcmp(this->pool + this->offsets[id], states, n * sizeof(int)) == 0;
+}
+
+// Return the slot holding the given subset, or the empty slot where it belongs.
+static int SubsetMap_find(SubsetMap this, uint32_t hash, const int* states, int n) {
+    int mask = this->capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    int probe = 1;
+    this->stats.lookups += 1;
+    while (this->slots[index] != -1 && !SubsetMap_matches(this, this->slots[index], hash, states, n)) {
+        this->stats.collisions += 1;
+        index = (index + 1) & mask;
+        probe += 1;
+    }
+    this->stats.probes += probe;
+    if (probe > this->stats.maxProbe) {
+        this->stats.maxProbe = probe;
+    }
+    return index;
+}
+
+// Double the table and reinsert every id using its cached hash.
+static void SubsetMap_grow(SubsetMap this) {
+    int capacity = this->capacity * 2;
+    int mask = capacity - 1;
+    int* slots = (int*)malloc(capacity * sizeof(int));
+    memset(slots, -1, capacity * sizeof(int));
+    for (int id = 0; id < this->count; id++) {
+        int index = (int)(this->hashes[id] & (uint32_t)mask);
+        while (slots[index] != -1) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = id;
+    }
+    free(this->slots);
+    this->slots = slots;
+    this->capacity = capacity;
+    this->maxCount = capacity / 2;
+    this->offsets = (int*)realloc(this->offsets, this->maxCount * sizeof(int));
+    this->lengths = (int*)realloc(this->lengths, this->maxCount * sizeof(int));
+    this->hashes = (uint32_t*)realloc(this->hashes, this->maxCount * sizeof(uint32_t));
+}
+
+int SubsetMap_intern(SubsetMap this, const int* states, int n, bool* added) {
+    uint32_t hash = SubsetMap_hash(states, n);
+    int index = SubsetMap_find(this, hash, states, n);
+    if (this->slots[index] != -1) {
+        if (added != NULL) {
+            *added = false;
+        }
+        return this->slots[index];
+    }
+    if (this->count == this->maxCount) {
+        SubsetMap_grow(this);
+        index = SubsetMap_find(this, hash, states, n);
+    }
+    if (this->poolSize + n > this->poolCapacity) {
+        while (this->poolSize + n > this->poolCapacity) {
+            this->poolCapacity *= 2;
+        }
+        this->pool = (int*)realloc(this->pool, this->poolCapacity * sizeof(int));
+    }
+    int id = this->count;
+    memcpy(this->pool + this->poolSize, states, n * sizeof(int));
+    this->offsets[id] = this->poolSize;
+    this->lengths[id] = n;
+    this->hashes[id] = hash;
+    this->poolSize += n;
+    this->slots[index] = id;
+    this->count += 1;
+    if (added != NULL) {
+        *added = true;
+    }
+    return id;
+}
+
+int SubsetMap_lookup(SubsetMap this, const int* states, int n) {
+    return this->slots[SubsetMap_find(this, SubsetMap_hash(states, n), states, n)];
+}
+
+const int* SubsetMap_get(SubsetMap this, int id, int* n) {
+    *n = this->lengths[id];
+    return this->pool + this->offsets[id];
+}
+
+int SubsetMap_count(SubsetMap this) {
+    return this->count;
+}
+
+void SubsetMap_get_stats(SubsetMap this, SubsetMapStats* stats) {
+    *stats = this->stats;
+    stats->count = this->count;
+    stats->capacity = this->capacity;
+}
+
+void SubsetMap_print_stats(SubsetMap this, FILE* out) {
+    SubsetMapStats stats;
+    SubsetMap_get_stats(this, &stats);
+    fprintf(out, "Subset table: %d subsets in %d slots, %ld lookups, %.2f probes/lookup, %ld collisions, longest probe %d\n",
+           stats.count, stats.capacity, stats.lookups,
+           stats.lookups == 0 ? 0.0 : (double)stats.probes / stats.lookups,
+           stats.collisions, stats.maxProbe);
+}
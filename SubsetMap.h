@@ -0,0 +1,76 @@
+//
+// File: SubsetMap.h
+// Created: 10/17/2026
+//
+// Hash table that interns sets of NFA states (subsets) and numbers them in
+// the order they are first seen, for use by subset construction.
+//
+
+#ifndef SUBSETMAP_H
+#define SUBSETMAP_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct SubsetMap* SubsetMap;
+
+/**
+ * Counters describing how well the hash function is spreading subsets.
+ * A probe is one slot examined during a lookup; a collision is a probe that
+ * landed on a slot holding a different subset.
+ */
+typedef struct SubsetMapStats {
+    long lookups;
+    long probes;
+    long collisions;
+    int maxProbe;
+    int count;
+    int capacity;
+} SubsetMapStats;
+
+/**
+ * Allocate and return a new empty SubsetMap with room for roughly the
+ * given number of subsets (it grows as needed).
+ */
+extern SubsetMap new_SubsetMap(int size);
+
+/**
+ * Free the given SubsetMap.
+ */
+extern void SubsetMap_free(SubsetMap this);
+
+/**
+ * Return the id of the subset given by the n sorted, distinct states in
+ * the given array, adding it with the next unused id if it isn't already
+ * present. If added is not NULL, it is set to whether the subset was new.
+ */
+extern int SubsetMap_intern(SubsetMap this, const int* states, int n, bool* added);
+
+/**
+ * Return the id of the given sorted subset, or -1 if it isn't present.
+ */
+extern int SubsetMap_lookup(SubsetMap this, const int* states, int n);
+
+/**
+ * Return the states of the subset with the given id and store its size in n.
+ * The returned array belongs to the map and is only valid until the next
+ * call to SubsetMap_intern.
+ */
+extern const int* SubsetMap_get(SubsetMap this, int id, int* n);
+
+/**
+ * Return the number of subsets in the given SubsetMap.
+ */
+extern int SubsetMap_count(SubsetMap this);
+
+/**
+ * Fill in the given stats with the lookup and collision counters.
+ */
+extern void SubsetMap_get_stats(SubsetMap this, SubsetMapStats* stats);
+
+/**
+ * Print the lookup and collision counters to the given stream.
+ */
+extern void SubsetMap_print_stats(SubsetMap this, FILE* out);
+
+#endif //SUBSETMAP_H
@@ -0,0 +1,258 @@
+//
+// File: batch.c
+// Created: 10/17/2026
+//
+// Non-interactive line-at-a-time matching for pipelines: input is read in
+// large blocks and results are written through one buffer, so the cost per
+// line is running the automaton rather than stdio.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "batch.h"
+#include "dfa.h"
+#include "nfa.h"
+#include "lazy.h"
+
+#define BATCH_BLOCK_SIZE (1 << 20)
+#define BATCH_OUTPUT_SIZE (1 << 16)
+
+bool Batch_match_DFA(void* automaton, const uint8_t* line, size_t length) {
+    return DFA_execute_buf(*(DFA*)automaton, line, length);
+}
+
+bool Batch_match_NFA(void* automaton, const uint8_t* line, size_t length) {
+    return NFA_execute_buf(*(NFA*)automaton, line, length);
+}
+
+bool Batch_match_LazyDFA(void* automaton, const uint8_t* line, size_t length) {
+    return LazyDFA_execute_buf((LazyDFA)automaton, line, length);
+}
+
+void Batch_match_many_DFA(void* automaton, const uint8_t* const* lines, const size_t* lengths,
+                          int n, bool* results) {
+    DFA_execute_many(*(DFA*)automaton, lines, lengths, n, results);
+}
+
+struct BatchReader {
+    FILE* in;
+    uint8_t* buffer;
+    size_t capacity;
+    size_t start;       // Carried-over partial line is buffer[start, end)
+    size_t end;
+    bool eof;
+};
+
+BatchReader new_BatchReader(FILE* in) {
+    BatchReader this = (BatchReader)malloc(sizeof(struct BatchReader));
+    this->in = in;
+    this->capacity = BATCH_BLOCK_SIZE;
+    this->buffer = (uint8_t*)malloc(this->capacity);
+    this->start = 0;
+    this->end = 0;
+    this->eof = false;
+    return this;
+}
+
+void BatchReader_free(BatchReader this) {
+    free(this->buffer);
+    free(this);
+}
+
+bool BatchReader_next(BatchReader this, const uint8_t** data, size_t* length) {
+    // Move the partial line left over from the last block to the front
+    size_t used = this->end - this->start;
+    memmove(this->buffer, this->buffer + this->start, used);
+    this->start = 0;
+    this->end = used;
+
+    size_t scanned = 0;     // Bytes already known to hold no newline
+    for (;;) {
+        if (!this->eof && this->end < this->capacity) {
+            size_t n = fread(this->buffer + this->end, 1, this->capacity - this->end, this->in);
+            this->end += n;
+            if (n == 0) {
+                this->eof = true;
+            }
+        }
+        // Hand out up to the last newline in the buffer
+        size_t last = this->end;
+        while (last > scanned && this->buffer[last - 1] != '\n') {
+            last--;
+        }
+        if (last > scanned) {
+            this->start = last;
+            break;
+        }
+        if (this->eof) {
+            // Whatever is left is the last line, which has no newline
+            this->start = this->end;
+            break;
+        }
+        scanned = this->end;
+        if (this->end == this->capacity) {
+            // A single line longer than the buffer: make room for more of it
+            this->capacity *= 2;
+            this->buffer = (uint8_t*)realloc(this->buffer, this->capacity);
+        }
+    }
+    *data = this->buffer;
+    *length = this->start;
+    return this->start > 0;
+}
+
+struct BatchWriter {
+    FILE* out;
+    BatchMode mode;
+    size_t accepted;
+    size_t total;
+    size_t used;
+    bool failed;
+    char buffer[BATCH_OUTPUT_SIZE];
+};
+
+BatchWriter new_BatchWriter(FILE* out, BatchMode mode) {
+    BatchWriter this = (BatchWriter)malloc(sizeof(struct BatchWriter));
+    this->out = out;
+    this->mode = mode;
+    this->accepted = 0;
+    this->total = 0;
+    this->used = 0;
+    this->failed = false;
+    return this;
+}
+
+// Write out the contents of the writer's buffer
+static void BatchWriter_flush(BatchWriter this) {
+    if (this->used > 0 && fwrite(this->buffer, 1, this->used, this->out) != this->used) {
+        this->failed = true;
+    }
+    this->used = 0;
+}
+
+// Append length bytes to the writer's buffer, flushing it as it fills up
+static void BatchWriter_append(BatchWriter this, const void* bytes, size_t length) {
+    if (this->used + length > BATCH_OUTPUT_SIZE) {
+        BatchWriter_flush(this);
+        if (length > BATCH_OUTPUT_SIZE) {
+            // Too big to buffer: write it straight through
+            if (fwrite(bytes, 1, length, this->out) != length) {
+                this->failed = true;
+            }
+            return;
+        }
+    }
+    memcpy(this->buffer + this->used, bytes, length);
+    this->used += length;
+}
+
+void BatchWriter_result(BatchWriter this, const uint8_t* line, size_t length, bool accepted) {
+    this->total += 1;
+    this->accepted += accepted;
+    switch (this->mode) {
+        case BATCH_BITMAP:
+            BatchWriter_append(this, accepted ? "1" : "0", 1);
+            break;
+        case BATCH_MATCHES:
+            if (accepted) {
+                BatchWriter_append(this, line, length);
+                BatchWriter_append(this, "\n", 1);
+            }
+            break;
+        case BATCH_COUNTS:
+            break;
+    }
+}
+
+int BatchWriter_finish(BatchWriter this) {
+    if (this->mode == BATCH_BITMAP) {
+        BatchWriter_append(this, "\n", 1);
+    } else if (this->mode == BATCH_COUNTS) {
+        char summary[64];
+        int n = snprintf(summary, sizeof(summary), "%zu %zu\n", this->accepted, this->total);
+        BatchWriter_append(this, summary, n);
+    }
+    BatchWriter_flush(this);
+    if (fflush(this->out) != 0) {
+        this->failed = true;
+    }
+    int status = this->failed ? -1 : 0;
+    free(this);
+    return status;
+}
+
+// Lines handed to a BatchManyMatcher at a time
+#define BATCH_GROUP 256
+
+size_t Batch_evaluate(BatchMatcher matcher, BatchManyMatcher many, void* automaton,
+                      const uint8_t* data, size_t length, bool** results, size_t* capacity) {
+    const uint8_t* lines[BATCH_GROUP];
+    size_t lengths[BATCH_GROUP];
+    size_t count = 0;
+    size_t start = 0;
+    while (start < length) {
+        // Gather the next group of lines
+        int n = 0;
+        while (n < BATCH_GROUP && start < length) {
+            const uint8_t* newline = memchr(data + start, '\n', length - start);
+            size_t end = newline == NULL ? length : (size_t)(newline - data);
+            lines[n] = data + start;
+            lengths[n] = end - start;
+            n++;
+            start = end + 1;
+        }
+        if (count + n > *capacity) {
+            while (count + n > *capacity) {
+                *capacity = *capacity == 0 ? 4096 : *capacity * 2;
+            }
+            *results = (bool*)realloc(*results, *capacity * sizeof(bool));
+        }
+        if (many != NULL) {
+            many(automaton, lines, lengths, n, *results + count);
+        } else {
+            for (int i = 0; i < n; i++) {
+                (*results)[count + i] = matcher(automaton, lines[i], lengths[i]);
+            }
+        }
+        count += n;
+    }
+    return count;
+}
+
+void Batch_write(BatchWriter writer, const uint8_t* data, size_t length, const bool* results, size_t count) {
+    size_t start = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* newline = memchr(data + start, '\n', length - start);
+        size_t end = newline == NULL ? length : (size_t)(newline - data);
+        BatchWriter_result(writer, data + start, end - start, results[i]);
+        start = end + 1;
+    }
+}
+
+int Batch_run(FILE* in, FILE* out, BatchMode mode, BatchMatcher matcher, BatchManyMatcher many,
+              void* automaton) {
+    BatchReader reader = new_BatchReader(in);
+    BatchWriter writer = new_BatchWriter(out, mode);
+    bool* results = NULL;
+    size_t capacity = 0;
+    const uint8_t* data;
+    size_t length;
+    while (BatchReader_next(reader, &data, &length)) {
+        size_t count = Batch_evaluate(matcher, many, automaton, data, length, &results, &capacity);
+        Batch_write(writer, data, length, results, count);
+    }
+    free(results);
+    int status = 0;
+    if (ferror(in)) {
+        fprintf(stderr, "error reading input: %s\n", strerror(errno));
+        status = -1;
+    }
+    BatchReader_free(reader);
+    if (BatchWriter_finish(writer) != 0) {
+        fprintf(stderr, "error writing output: %s\n", strerror(errno));
+        status = -1;
+    }
+    return status;
+}
@@ -0,0 +1,120 @@
+//
+// File: batch.h
+// Created: 10/17/2026
+//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * What batch mode writes for its input lines.
+ *  BATCH_BITMAP:  one '1' (accepted) or '0' (rejected) per line, then a newline
+ *  BATCH_COUNTS:  a single "<accepted> <total>" line at the end
+ *  BATCH_MATCHES: each accepted line, in input order (like grep)
+ */
+typedef enum { BATCH_BITMAP, BATCH_COUNTS, BATCH_MATCHES } BatchMode;
+
+/**
+ * Decides whether one input line is accepted. automaton is whatever was
+ * passed to Batch_run (a DFA* or NFA*); line does not include its newline.
+ */
+typedef bool (*BatchMatcher)(void* automaton, const uint8_t* line, size_t length);
+
+/**
+ * Decides whether each of n input lines is accepted, storing the results in
+ * results[0..n-1]. An automaton that can run several lines faster together
+ * than one at a time passes one of these along with its BatchMatcher; where
+ * the batch functions take one, NULL means lines are matched one at a time.
+ */
+typedef void (*BatchManyMatcher)(void* automaton, const uint8_t* const* lines, const size_t* lengths,
+                                 int n, bool* results);
+
+/**
+ * Matchers for the two kinds of automata (automaton is a DFA* or NFA*).
+ */
+extern bool Batch_match_DFA(void* automaton, const uint8_t* line, size_t length);
+extern bool Batch_match_NFA(void* automaton, const uint8_t* line, size_t length);
+
+/**
+ * Matcher for a LazyDFA (automaton is the LazyDFA itself). A LazyDFA fills
+ * its cache as it runs, so it can't be shared by Batch_run_parallel's workers.
+ */
+extern bool Batch_match_LazyDFA(void* automaton, const uint8_t* line, size_t length);
+
+/**
+ * Many-line matcher for DFAs, which runs the lines interleaved with
+ * DFA_execute_many.
+ */
+extern void Batch_match_many_DFA(void* automaton, const uint8_t* const* lines, const size_t* lengths,
+                                 int n, bool* results);
+
+/**
+ * A BatchReader reads newline-delimited input in large blocks, handing out
+ * only whole lines; a line cut off at the end of a block is carried over to
+ * the start of the next one. A final line without a newline still counts.
+ */
+typedef struct BatchReader* BatchReader;
+
+extern BatchReader new_BatchReader(FILE* in);
+extern void BatchReader_free(BatchReader reader);
+
+/**
+ * Read the next block of whole lines into the reader's buffer and set *data
+ * and *length to it (every line in it ends in a newline, except possibly the
+ * last line of the input). The block stays valid until the next call.
+ * Returns false at the end of the input.
+ */
+extern bool BatchReader_next(BatchReader reader, const uint8_t** data, size_t* length);
+
+/**
+ * A BatchWriter collects the results for one BatchMode in a large buffer
+ * and writes them out with one fwrite per buffer-full, instead of a printf
+ * and a flush per line.
+ */
+typedef struct BatchWriter* BatchWriter;
+
+extern BatchWriter new_BatchWriter(FILE* out, BatchMode mode);
+
+/**
+ * Record the result for one line (line points at its bytes, without the
+ * newline, for BATCH_MATCHES).
+ */
+extern void BatchWriter_result(BatchWriter writer, const uint8_t* line, size_t length, bool accepted);
+
+/**
+ * Write out everything still buffered (and the summary line for
+ * BATCH_COUNTS), then free the writer. Returns 0, or -1 if writing failed.
+ */
+extern int BatchWriter_finish(BatchWriter writer);
+
+/**
+ * Run the matcher on every line of the given block (lines end in newlines,
+ * except possibly the last) and store the results in order in *results,
+ * which is grown (with realloc, *capacity tracking its size) as needed.
+ * Returns the number of lines. If many is not NULL, the lines are handed to
+ * it in groups instead of to the matcher one by one.
+ */
+extern size_t Batch_evaluate(BatchMatcher matcher, BatchManyMatcher many, void* automaton,
+                             const uint8_t* data, size_t length, bool** results, size_t* capacity);
+
+/**
+ * Record the given results (from Batch_evaluate) for the lines of the given
+ * block with the writer.
+ */
+extern void Batch_write(BatchWriter writer, const uint8_t* data, size_t length,
+                        const bool* results, size_t count);
+
+/**
+ * Run the matcher over every line of in and write the results to out in the
+ * given mode. Returns 0, or -1 (after printing an error message) if reading
+ * or writing failed.
+ */
+extern int Batch_run(FILE* in, FILE* out, BatchMode mode, BatchMatcher matcher, BatchManyMatcher many,
+                     void* automaton);
+
+#endif //BATCH_H
@@ -4,45 +4,341 @@
 // Created: 1/30/2024
 //
 
+#define _POSIX_C_SOURCE 200809L     // For mmap
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "dfa.h"
-#include "IntHashSet.h"
+#include "simd.h"
+#include "SubsetMap.h"
+
+#define ALPHABET DFA_ALPHABET_SIZE
 
+// Transitions are stored in one contiguous row-major table. Input symbols
+// are first mapped to equivalence classes (symbols that every state treats
+// the same way share a class), and row src holds the next state for each
+// class. A new DFA starts with one class per symbol; DFA_compress merges
+// them once the DFA is built. Entries are as narrow as the number of states
+// allows (1, 2 or 4 bytes), and the all-ones value of that width means "no
+// transition" (the reject state), so a one-byte table holds up to 255
+// states. Accepting states are kept as a bitmap.
+//
+// DFA_compress, the last step in building a DFA, also prepares two faster
+// ways of running it, which are dropped again when a transition changes
+// (execution then goes back to the plain table until the next DFA_compress):
+//  - A DFA with at most 16 states (counting the reject state) gets a copy of
+//    its table as one 16-byte shuffle vector per class, which DFA_advance
+//    runs with SIMD_shuffle_advance.
+//  - For every state that goes to itself on all but a few input bytes (the
+//    start state of a "contains" automaton, say), those bytes are noted, and
+//    while the DFA is in that state it skips straight to the next of them
+//    with SIMD_find_any. A state that can't be left at all (no such bytes)
+//    decides the rest of the input, so the run ends there.
+//
+// A DFA built from several patterns (NFA_union_to_DFA) also tags each state
+// with the set of pattern ids it matches. The distinct sets are interned in
+// a SubsetMap, with the empty set as id 0, and each state keeps the id of
+// its set; a DFA without tags has no per-state array at all.
+//
+// DFA_save writes all of this to a file laid out so that DFA_load can map it
+// and point the table, the accept bitmap, the skip arrays and the pattern
+// set ids straight into the mapping (see "Files" below). A mapped DFA is
+// read-only; the first change to it copies those arrays to the heap.
 struct DFA {
-    int** transitions;
-    int* acceptingStates;
+    void* table;
+    int width;                  // Bytes per table entry
+    uint8_t classes[ALPHABET];  // Class of each input symbol
+    int numClasses;             // Entries per row
+    uint8_t* accepting;         // Bit i set if state i is accepting
     int numStates;
+    int capacity;               // Rows allocated in table
     int initialState;
+    bool prepared;              // Set by DFA_compress, cleared when the table changes
+    uint8_t* shuffle;           // Shuffle vectors for SIMD_shuffle_advance, or NULL
+    int shuffleDead;            // Index of the reject state in them, or -1
+    int8_t* skipCount;          // Bytes that leave each state, -1 if too many (NULL if none can skip)
+    uint8_t* skipBytes;         // The bytes leaving state s at skipBytes[s * SIMD_FIND_MAX]
+    SubsetMap patterns;         // Distinct sets of pattern ids, or NULL if no state is tagged
+    int* patternSet;            // Id of each state's set in patterns
+    void* mapping;              // File some of the arrays above point into (DFA_load), or NULL
+    size_t mappingSize;
 };
 
-// Allocate and return a new DFA containing the given number of states.
-DFA new_DFA(int nstates){
+// Smallest entry width whose all-ones value can't be mistaken for one of nstates states
+static int DFA_width_for(int nstates) {
+    if (nstates <= UINT8_MAX) {
+        return 1;
+    } else if (nstates <= UINT16_MAX) {
+        return 2;
+    }
+    return 4;
+}
+
+// Read entry i of the given table, returning -1 for the reject state
+static inline int DFA_entry(const void* table, int width, size_t i) {
+    switch (width) {
+        case 1: {
+            uint8_t v = ((const uint8_t*)table)[i];
+            return v == UINT8_MAX ? -1 : v;
+        }
+        case 2: {
+            uint16_t v = ((const uint16_t*)table)[i];
+            return v == UINT16_MAX ? -1 : v;
+        }
+        default:
+            return (int)((const int32_t*)table)[i];
+    }
+}
+
+// Write entry i of the given table (-1 is stored as all ones at any width)
+static inline void DFA_set_entry(void* table, int width, size_t i, int value) {
+    switch (width) {
+        case 1:
+            ((uint8_t*)table)[i] = (uint8_t)value;
+            break;
+        case 2:
+            ((uint16_t*)table)[i] = (uint16_t)value;
+            break;
+        default:
+            ((int32_t*)table)[i] = value;
+            break;
+    }
+}
+
+// Reallocate the table for the given number of rows and entry width,
+// converting existing entries if the width changes.
+static void DFA_resize(DFA dfa, int capacity, int width) {
+    size_t entries = (size_t)capacity * dfa->numClasses;
+    if (width == dfa->width) {
+        dfa->table = realloc(dfa->table, entries * width);
+    } else {
+        void* table = malloc(entries * width);
+        for (size_t i = 0; i < (size_t)dfa->numStates * dfa->numClasses; i++) {
+            DFA_set_entry(table, width, i, DFA_entry(dfa->table, dfa->width, i));
+        }
+        free(dfa->table);
+        dfa->table = table;
+        dfa->width = width;
+    }
+    dfa->accepting = (uint8_t*)realloc(dfa->accepting, (capacity + 7) / 8);
+    if (dfa->patternSet != NULL) {
+        dfa->patternSet = (int*)realloc(dfa->patternSet, capacity * sizeof(int));
+    }
+    dfa->capacity = capacity;
+}
+
+// Allocate and return a new DFA containing the given number of states, whose
+// input symbols are grouped into the given classes (classes[sym] is the class of
+// sym, numbered from 0 to nclasses-1).
+DFA new_DFA_classes(int nstates, const unsigned char* classes, int nclasses){
     DFA dfa = (DFA)malloc(sizeof(struct DFA));
     dfa->numStates = nstates;
+    dfa->capacity = nstates;
     dfa->initialState = 0;
-    dfa->acceptingStates = (int*)malloc(nstates * sizeof(int));
-    dfa->transitions = (int**)malloc(nstates * sizeof(int*));
+    memcpy(dfa->classes, classes, ALPHABET);
+    dfa->numClasses = nclasses;
+    dfa->width = DFA_width_for(nstates);
+    dfa->table = malloc((size_t)nstates * nclasses * dfa->width);
+    memset(dfa->table, 0xFF, (size_t)nstates * nclasses * dfa->width); // Initialize transitions to reject
+    dfa->accepting = (uint8_t*)calloc((nstates + 7) / 8, 1);          // Initialize all states as non-accepting
+    dfa->prepared = false;
+    dfa->shuffle = NULL;
+    dfa->shuffleDead = -1;
+    dfa->skipCount = NULL;
+    dfa->skipBytes = NULL;
+    dfa->patterns = NULL;
+    dfa->patternSet = NULL;
+    dfa->mapping = NULL;
+    dfa->mappingSize = 0;
+    return dfa;
+}
 
-    for (int i = 0; i < nstates; i++) {
-        dfa->transitions[i] = (int*)malloc(128 * sizeof(int));
-        memset(dfa->transitions[i], -1, 128 * sizeof(int)); // Initialize transitions to -1 (reject state)
+// Allocate and return a new DFA containing the given number of states.
+DFA new_DFA(int nstates){
+    unsigned char classes[ALPHABET];
+    for (int sym = 0; sym < ALPHABET; sym++) {
+        classes[sym] = (unsigned char)sym;
+    }
+    return new_DFA_classes(nstates, classes, ALPHABET);
+}
+
+// Return true if the given pointer is into the file the given DFA was loaded from.
+static bool DFA_mapped(DFA dfa, const void* p){
+    const uint8_t* start = (const uint8_t*)dfa->mapping;
+    return start != NULL && (const uint8_t*)p >= start && (const uint8_t*)p < start + dfa->mappingSize;
+}
+
+// Free the given array of the given DFA, unless it is part of the DFA's file.
+static void DFA_free_array(DFA dfa, void* array){
+    if (!DFA_mapped(dfa, array)) {
+        free(array);
     }
-    memset(dfa->acceptingStates, 0, nstates * sizeof(int)); // Initialize all states as non-accepting
-    return dfa;
+}
+
+// Return a copy on the heap of the given array of the given DFA, which is
+// part of the DFA's file.
+static void* DFA_copy_array(DFA dfa, void* array, size_t size){
+    if (!DFA_mapped(dfa, array)) {
+        return array;
+    }
+    void* copy = malloc(size);
+    memcpy(copy, array, size);
+    return copy;
+}
+
+// Copy every array of the given DFA that is part of its file to the heap and
+// unmap the file, so the DFA can be changed. Does nothing for a DFA that
+// wasn't loaded from a file.
+static void DFA_own(DFA dfa){
+    if (dfa->mapping == NULL) {
+        return;
+    }
+    size_t n = dfa->numStates;
+    dfa->table = DFA_copy_array(dfa, dfa->table, n * dfa->numClasses * dfa->width);
+    dfa->accepting = (uint8_t*)DFA_copy_array(dfa, dfa->accepting, (n + 7) / 8);
+    if (dfa->skipCount != NULL) {
+        dfa->skipCount = (int8_t*)DFA_copy_array(dfa, dfa->skipCount, n);
+        dfa->skipBytes = (uint8_t*)DFA_copy_array(dfa, dfa->skipBytes, n * SIMD_FIND_MAX);
+    }
+    if (dfa->patternSet != NULL) {
+        dfa->patternSet = (int*)DFA_copy_array(dfa, dfa->patternSet, n * sizeof(int));
+    }
+    munmap(dfa->mapping, dfa->mappingSize);
+    dfa->mapping = NULL;
+    dfa->mappingSize = 0;
+    dfa->capacity = dfa->numStates;
 }
 
 // Free the given DFA.
 void DFA_free(DFA dfa){
-    for (int i = 0; i < dfa->numStates; i++) {
-        free(dfa->transitions[i]);
+    free(dfa->shuffle);
+    DFA_free_array(dfa, dfa->skipCount);
+    DFA_free_array(dfa, dfa->skipBytes);
+    DFA_free_array(dfa, dfa->table);
+    DFA_free_array(dfa, dfa->accepting);
+    if (dfa->patterns != NULL) {
+        SubsetMap_free(dfa->patterns);
+    }
+    DFA_free_array(dfa, dfa->patternSet);
+    if (dfa->mapping != NULL) {
+        munmap(dfa->mapping, dfa->mappingSize);
     }
-    free(dfa->transitions);
-    free(dfa->acceptingStates);
     free(dfa);
 }
 
+// Drop what DFA_prepare built for the given DFA, which no longer matches its table.
+static void DFA_discard_prepared(DFA dfa){
+    free(dfa->shuffle);
+    dfa->shuffle = NULL;
+    free(dfa->skipCount);
+    free(dfa->skipBytes);
+    dfa->skipCount = NULL;
+    dfa->skipBytes = NULL;
+    dfa->prepared = false;
+}
+
+// Build the shuffle vectors for the given DFA, if it is small enough and the
+// machine can run them. The reject state gets the first index past the real
+// states, and goes to itself on every class.
+static void DFA_build_shuffle(DFA dfa){
+    if (dfa->numStates > SIMD_SHUFFLE_STATES || !SIMD_shuffle_supported()) {
+        return;
+    }
+    bool rejects = false;
+    for (size_t i = 0; i < (size_t)dfa->numStates * dfa->numClasses && !rejects; i++) {
+        rejects = DFA_entry(dfa->table, dfa->width, i) == -1;
+    }
+    if (rejects && dfa->numStates == SIMD_SHUFFLE_STATES) {
+        return;
+    }
+    int dead = rejects ? dfa->numStates : -1;
+    dfa->shuffle = (uint8_t*)calloc((size_t)dfa->numClasses * 16, 1);
+    for (int cls = 0; cls < dfa->numClasses; cls++) {
+        uint8_t* vector = dfa->shuffle + 16 * cls;
+        for (int src = 0; src < dfa->numStates; src++) {
+            int dst = DFA_get_class_transition(dfa, src, cls);
+            vector[src] = (uint8_t)(dst == -1 ? dead : dst);
+        }
+        if (rejects) {
+            vector[dead] = (uint8_t)dead;
+        }
+    }
+    dfa->shuffleDead = dead;
+}
+
+// For each state of the given DFA, note the bytes that take it somewhere else,
+// if there are at most SIMD_FIND_MAX of them. The arrays are only kept if at
+// least one state can skip.
+static void DFA_build_skip(DFA dfa){
+    int8_t* counts = (int8_t*)malloc(dfa->numStates);
+    uint8_t* bytes = (uint8_t*)malloc((size_t)dfa->numStates * SIMD_FIND_MAX);
+    bool any = false;
+    for (int state = 0; state < dfa->numStates; state++) {
+        int count = 0;
+        for (int sym = 0; sym < ALPHABET && count != -1; sym++) {
+            if (DFA_get_class_transition(dfa, state, dfa->classes[sym]) != state) {
+                if (count == SIMD_FIND_MAX) {
+                    count = -1;
+                } else {
+                    bytes[(size_t)state * SIMD_FIND_MAX + count++] = (uint8_t)sym;
+                }
+            }
+        }
+        counts[state] = (int8_t)count;
+        any |= count != -1;
+    }
+    if (any) {
+        dfa->skipCount = counts;
+        dfa->skipBytes = bytes;
+    } else {
+        free(counts);
+        free(bytes);
+    }
+}
+
+// Build the faster ways of running the given DFA described at the top, unless
+// they are already built.
+void DFA_prepare(DFA dfa){
+    if (dfa->prepared) {
+        return;
+    }
+    DFA_discard_prepared(dfa);
+    DFA_build_shuffle(dfa);
+    DFA_build_skip(dfa);
+    dfa->prepared = true;
+}
+
+// Add a new (non-accepting, all-reject) state to the given DFA and return its index.
+// Storage grows geometrically so building a DFA one state at a time stays linear,
+// and the table entries are widened when the state count outgrows them.
+int DFA_add_state(DFA dfa){
+    DFA_own(dfa);
+    DFA_discard_prepared(dfa);
+    int width = DFA_width_for(dfa->numStates + 1);
+    if (dfa->numStates == dfa->capacity || width != dfa->width) {
+        int capacity = dfa->capacity;
+        if (dfa->numStates == capacity) {
+            capacity = capacity < 8 ? 8 : capacity * 2;
+        }
+        DFA_resize(dfa, capacity, width);
+    }
+    int state = dfa->numStates;
+    size_t row = (size_t)dfa->numClasses * dfa->width;
+    memset((char*)dfa->table + state * row, 0xFF, row);
+    dfa->accepting[state / 8] &= (uint8_t)~(1 << (state % 8));
+    if (dfa->patternSet != NULL) {
+        dfa->patternSet[state] = 0;
+    }
+    dfa->numStates += 1;
+    return state;
+}
+
 // Return the number of states in the given DFA.
 int DFA_get_size(DFA dfa){
     return dfa->numStates;
@@ -56,14 +352,112 @@ int DFA_set_initialState(DFA dfa, int i){
     return dfa->initialState = i;
 }
 
+// Return the number of input symbol classes (entries per table row) in the given DFA.
+int DFA_get_num_classes(DFA dfa){
+    return dfa->numClasses;
+}
+
+// Return the class of the given input symbol.
+int DFA_get_class(DFA dfa, char sym){
+    return dfa->classes[(unsigned char)sym];
+}
+
+// Return the state the given DFA moves to from state src on any symbol in class cls.
+int DFA_get_class_transition(DFA dfa, int src, int cls){
+    return DFA_entry(dfa->table, dfa->width, (size_t)src * dfa->numClasses + cls);
+}
+
+// Set the transition from state src on every symbol in class cls to be the state dst.
+void DFA_set_class_transition(DFA dfa, int src, int cls, int dst){
+    DFA_own(dfa);
+    if (dfa->prepared) {
+        DFA_discard_prepared(dfa);
+    }
+    DFA_set_entry(dfa->table, dfa->width, (size_t)src * dfa->numClasses + cls, dst);
+}
+
+// Go back to one class per symbol, so a single symbol's transition can be changed.
+static void DFA_expand(DFA dfa){
+    DFA_own(dfa);
+    DFA_discard_prepared(dfa);
+    size_t entries = (size_t)dfa->capacity * ALPHABET;
+    void* table = malloc(entries * dfa->width);
+    for (int src = 0; src < dfa->numStates; src++) {
+        for (int sym = 0; sym < ALPHABET; sym++) {
+            DFA_set_entry(table, dfa->width, (size_t)src * ALPHABET + sym,
+                          DFA_get_class_transition(dfa, src, dfa->classes[sym]));
+        }
+    }
+    free(dfa->table);
+    dfa->table = table;
+    for (int sym = 0; sym < ALPHABET; sym++) {
+        dfa->classes[sym] = (uint8_t)sym;
+    }
+    dfa->numClasses = ALPHABET;
+}
+
+// Merge input classes whose table columns are identical, shrinking every row
+// to the number of distinct columns, and return the new number of classes.
+// This is also where the faster ways of running the DFA are prepared.
+int DFA_compress(DFA dfa){
+    DFA_own(dfa);
+    int n = dfa->numStates;
+    int* merged = (int*)malloc(dfa->numClasses * sizeof(int));  // New class of each old class
+    int* representative = (int*)malloc(dfa->numClasses * sizeof(int));  // Old class standing for each new one
+    int count = 0;
+    for (int cls = 0; cls < dfa->numClasses; cls++) {
+        merged[cls] = -1;
+        for (int other = 0; other < count && merged[cls] == -1; other++) {
+            bool same = true;
+            for (int src = 0; src < n && same; src++) {
+                same = DFA_get_class_transition(dfa, src, cls) == DFA_get_class_transition(dfa, src, representative[other]);
+            }
+            if (same) {
+                merged[cls] = other;
+            }
+        }
+        if (merged[cls] == -1) {
+            representative[count] = cls;
+            merged[cls] = count++;
+        }
+    }
+    if (count < dfa->numClasses) {
+        void* table = malloc((size_t)dfa->capacity * count * dfa->width);
+        for (int src = 0; src < n; src++) {
+            for (int cls = 0; cls < count; cls++) {
+                DFA_set_entry(table, dfa->width, (size_t)src * count + cls,
+                              DFA_get_class_transition(dfa, src, representative[cls]));
+            }
+        }
+        free(dfa->table);
+        dfa->table = table;
+        for (int sym = 0; sym < ALPHABET; sym++) {
+            dfa->classes[sym] = (uint8_t)merged[dfa->classes[sym]];
+        }
+        DFA_discard_prepared(dfa);
+        dfa->numClasses = count;
+    }
+    free(merged);
+    free(representative);
+    DFA_prepare(dfa);
+    return count;
+}
+
 // Return the state specified by the given DFA's transition function from state src on input symbol sym.
 int DFA_get_transition(DFA dfa, int src, char sym){
-    return dfa->transitions[src][(int)sym];
+    return DFA_get_class_transition(dfa, src, dfa->classes[(unsigned char)sym]);
 }
 
 // For the given DFA, set the transition from state src on input symbol sym to be the state dst.
+// If sym shares its class with other symbols the table is first expanded back to one class per symbol.
 void DFA_set_transition(DFA dfa, int src, char sym, int dst){
-    dfa->transitions[src][(int)sym] = dst;
+    if (DFA_get_transition(dfa, src, sym) == dst) {
+        return;
+    }
+    if (dfa->numClasses < ALPHABET) {
+        DFA_expand(dfa);
+    }
+    DFA_set_class_transition(dfa, src, (unsigned char)sym, dst);
 }
 
 // Set the transitions of the given DFA for each symbol in the given str.
@@ -75,7 +469,7 @@ void DFA_set_transition_str(DFA dfa, int src, char *str, int dst){
 
 //Set the transitions of the given DFA for all input symbols.
 void DFA_set_transition_all(DFA dfa, int src, int dst){
-    for (int i = 0; i < 128; i++) {
+    for (int i = 0; i < ALPHABET; i++) {
         DFA_set_transition(dfa, src, i, dst);
     }
 }
@@ -83,63 +477,1001 @@ void DFA_set_transition_all(DFA dfa, int src, int dst){
 
 // Set whether the given DFA's state is accepting or not.
 void DFA_set_accepting(DFA dfa, int state, bool value){
-    dfa->acceptingStates[state] = value ? 1 : 0;
+    DFA_own(dfa);
+    if (value) {
+        dfa->accepting[state / 8] |= (uint8_t)(1 << (state % 8));
+    } else {
+        dfa->accepting[state / 8] &= (uint8_t)~(1 << (state % 8));
+    }
 }
 
 // Return true if the given DFA's state is an accepting state.
 bool DFA_get_accepting(DFA dfa, int state){
-    return dfa->acceptingStates[state] == 1;
+    return (dfa->accepting[state / 8] >> (state % 8)) & 1;
+}
+
+// Tag the given state of the given DFA with the n sorted, distinct pattern ids in ids.
+void DFA_set_patterns(DFA dfa, int state, const int* ids, int n){
+    DFA_own(dfa);
+    if (dfa->patterns == NULL) {
+        if (n == 0) {
+            return;
+        }
+        dfa->patterns = new_SubsetMap(16);
+        int none = 0;
+        SubsetMap_intern(dfa->patterns, &none, 0, NULL);    // The empty set is id 0
+        dfa->patternSet = (int*)calloc(dfa->capacity, sizeof(int));
+    }
+    dfa->patternSet[state] = SubsetMap_intern(dfa->patterns, ids, n, NULL);
+}
+
+// Return the pattern ids the given state is tagged with, storing how many there are in n.
+const int* DFA_get_patterns(DFA dfa, int state, int* n){
+    if (dfa->patterns == NULL) {
+        *n = 0;
+        return NULL;
+    }
+    return SubsetMap_get(dfa->patterns, dfa->patternSet[state], n);
+}
+
+// Return a number identifying the given state's set of pattern ids (0 for none).
+int DFA_get_pattern_set(DFA dfa, int state){
+    return dfa->patternSet == NULL ? 0 : dfa->patternSet[state];
+}
+
+// Run the given DFA on length bytes of input and return the pattern ids of the
+// state it ends in, storing how many there are in n (0 if the input is rejected).
+const int* DFA_execute_patterns(DFA dfa, const uint8_t* input, size_t length, int* n){
+    int state = DFA_advance(dfa, dfa->initialState, input, length);
+    if (state == -1) {
+        *n = 0;
+        return NULL;
+    }
+    return DFA_get_patterns(dfa, state, n);
+}
+
+// Inner loop of DFA_advance for one table entry type: follow the table
+// directly, stopping as soon as the reject state (all ones) is reached.
+#define DFA_RUN(TYPE, DEAD)                                                 \
+    static int DFA_run_##TYPE(const TYPE* table, const uint8_t* classes, int stride, \
+                              int state, const uint8_t* input, size_t length) { \
+        for (size_t i = 0; i < length; i++) {                               \
+            TYPE next = table[(size_t)state * stride + classes[input[i]]];  \
+            if (next == (TYPE)(DEAD)) {                                     \
+                return -1;                                                  \
+            }                                                               \
+            state = (int)next;                                              \
+        }                                                                   \
+        return state;                                                       \
+    }
+
+// Same, but also stop right after entering an accepting state. Stores the
+// state reached in *state and returns the number of bytes read.
+#define DFA_RUN_TO_ACCEPT(TYPE, DEAD)                                       \
+    static size_t DFA_run_to_accept_##TYPE(const TYPE* table, const uint8_t* classes, int stride, \
+                                           const uint8_t* accepting, int* state, \
+                                           const uint8_t* input, size_t length) { \
+        int current = *state;                                               \
+        for (size_t i = 0; i < length; i++) {                               \
+            TYPE next = table[(size_t)current * stride + classes[input[i]]]; \
+            if (next == (TYPE)(DEAD)) {                                     \
+                *state = -1;                                                \
+                return i + 1;                                               \
+            }                                                               \
+            current = (int)next;                                            \
+            if ((accepting[current / 8] >> (current % 8)) & 1) {            \
+                *state = current;                                           \
+                return i + 1;                                               \
+            }                                                               \
+        }                                                                   \
+        *state = current;                                                   \
+        return length;                                                      \
+    }
+
+// Advance each of n states (-1 for the reject state) over the same input,
+// four at a time in locals, one byte at a time for all four, so that their
+// table lookups overlap instead of waiting on each other.
+#define DFA_STEP(TYPE, DEAD, s, cls)                                        \
+    if (s != -1) {                                                          \
+        TYPE next = table[(size_t)s * stride + cls];                        \
+        s = next == (TYPE)(DEAD) ? -1 : (int)next;                          \
+    }
+#define DFA_RUN_ALL(TYPE, DEAD)                                             \
+    static void DFA_run_all_##TYPE(const TYPE* table, const uint8_t* classes, int stride, \
+                                   int* states, int n, const uint8_t* input, size_t length) { \
+        for (int j = 0; j < n; j += 4) {                                    \
+            int s0 = states[j];                                             \
+            int s1 = j + 1 < n ? states[j + 1] : -1;                        \
+            int s2 = j + 2 < n ? states[j + 2] : -1;                        \
+            int s3 = j + 3 < n ? states[j + 3] : -1;                        \
+            for (size_t i = 0; i < length; i++) {                           \
+                int cls = classes[input[i]];                                \
+                DFA_STEP(TYPE, DEAD, s0, cls)                               \
+                DFA_STEP(TYPE, DEAD, s1, cls)                               \
+                DFA_STEP(TYPE, DEAD, s2, cls)                               \
+                DFA_STEP(TYPE, DEAD, s3, cls)                               \
+            }                                                               \
+            states[j] = s0;                                                 \
+            if (j + 1 < n) states[j + 1] = s1;                              \
+            if (j + 2 < n) states[j + 2] = s2;                              \
+            if (j + 3 < n) states[j + 3] = s3;                              \
+        }                                                                   \
+    }
+
+// Tables up to this many bytes are assumed to fit in the L1 cache
+#define DFA_SMALL_TABLE (32 * 1024)
+
+// Run up to DFA_LANES inputs at once, taking one step in each busy lane per
+// pass. A lane whose input is used up (or that has been rejected) records
+// its result and starts the next input.
+#define DFA_RUN_MANY(TYPE, DEAD)                                            \
+    static void DFA_run_many_##TYPE(const TYPE* table, const uint8_t* classes, int stride, \
+                                    const uint8_t* accepting, int initial,  \
+                                    const uint8_t* const* inputs, const size_t* lengths, \
+                                    int n, bool* results) {                 \
+        int input[DFA_LANES];                                               \
+        int state[DFA_LANES];                                               \
+        const uint8_t* pos[DFA_LANES];                                      \
+        size_t left[DFA_LANES];                                             \
+        int nextInput = 0;                                                  \
+        int busy = 0;                                                       \
+        for (int l = 0; l < DFA_LANES; l++) {                               \
+            input[l] = -1;                                                  \
+            left[l] = 0;                                                    \
+        }                                                                   \
+        do {                                                                \
+            for (int l = 0; l < DFA_LANES; l++) {                           \
+                while (left[l] == 0) {                                      \
+                    if (input[l] != -1) {                                   \
+                        results[input[l]] = state[l] != -1                  \
+                            && ((accepting[state[l] / 8] >> (state[l] % 8)) & 1); \
+                        input[l] = -1;                                      \
+                        busy--;                                             \
+                    }                                                       \
+                    if (nextInput == n) {                                   \
+                        break;                                              \
+                    }                                                       \
+                    input[l] = nextInput++;                                 \
+                    state[l] = initial;                                     \
+                    pos[l] = inputs[input[l]];                              \
+                    left[l] = lengths[input[l]];                            \
+                    busy++;                                                 \
+                }                                                           \
+                if (input[l] == -1) {                                       \
+                    continue;                                               \
+                }                                                           \
+                TYPE next = table[(size_t)state[l] * stride + classes[*pos[l]++]]; \
+                if (next == (TYPE)(DEAD)) {                                 \
+                    state[l] = -1;                                          \
+                    left[l] = 0;                                            \
+                } else {                                                    \
+                    state[l] = (int)next;                                   \
+                    left[l]--;                                              \
+                }                                                           \
+            }                                                               \
+        } while (busy > 0);                                                 \
+    }
+
+DFA_RUN(uint8_t, UINT8_MAX)
+DFA_RUN(uint16_t, UINT16_MAX)
+DFA_RUN(int32_t, -1)
+DFA_RUN_TO_ACCEPT(uint8_t, UINT8_MAX)
+DFA_RUN_TO_ACCEPT(uint16_t, UINT16_MAX)
+DFA_RUN_TO_ACCEPT(int32_t, -1)
+DFA_RUN_ALL(uint8_t, UINT8_MAX)
+DFA_RUN_ALL(uint16_t, UINT16_MAX)
+DFA_RUN_ALL(int32_t, -1)
+DFA_RUN_MANY(uint8_t, UINT8_MAX)
+DFA_RUN_MANY(uint16_t, UINT16_MAX)
+DFA_RUN_MANY(int32_t, -1)
+
+// Run the given DFA from the given state over length bytes of input with the shuffle
+// vectors or the table, and return the state it ends up in, or -1.
+static int DFA_run(DFA dfa, int state, const uint8_t* input, size_t length){
+    if (dfa->shuffle != NULL) {
+        state = SIMD_shuffle_advance(dfa->shuffle, dfa->classes, state, dfa->shuffleDead, input, length);
+        return state == dfa->shuffleDead ? -1 : state;
+    }
+    switch (dfa->width) {
+        case 1:
+            return DFA_run_uint8_t((const uint8_t*)dfa->table, dfa->classes, dfa->numClasses, state, input, length);
+        case 2:
+            return DFA_run_uint16_t((const uint16_t*)dfa->table, dfa->classes, dfa->numClasses, state, input, length);
+        default:
+            return DFA_run_int32_t((const int32_t*)dfa->table, dfa->classes, dfa->numClasses, state, input, length);
+    }
+}
+
+// Same for DFA_advance_to_accept.
+static size_t DFA_run_to_accept(DFA dfa, int* state, const uint8_t* input, size_t length){
+    switch (dfa->width) {
+        case 1:
+            return DFA_run_to_accept_uint8_t((const uint8_t*)dfa->table, dfa->classes, dfa->numClasses,
+                                             dfa->accepting, state, input, length);
+        case 2:
+            return DFA_run_to_accept_uint16_t((const uint16_t*)dfa->table, dfa->classes, dfa->numClasses,
+                                              dfa->accepting, state, input, length);
+        default:
+            return DFA_run_to_accept_int32_t((const int32_t*)dfa->table, dfa->classes, dfa->numClasses,
+                                             dfa->accepting, state, input, length);
+    }
+}
+
+// Skipping ahead: after each skip (or whenever the DFA is in a state it can't
+// skip in) the DFA is run normally for DFA_SKIP_RUN bytes before checking its
+// state again, or for SIMD_SKIP_BACKOFF bytes if skipping hasn't been paying
+// off (see simd.h).
+#define DFA_SKIP_RUN 32
+
+// If the given state can skip, skip to the next byte at or after input[*i]
+// that would take the DFA out of it, and return how many bytes to run
+// normally next.
+static size_t DFA_skip(DFA dfa, int state, const uint8_t* input, size_t length, size_t* i, int* misses){
+    size_t run = DFA_SKIP_RUN;
+    if (dfa->skipCount[state] != -1) {
+        size_t skip = SIMD_find_any(dfa->skipBytes + (size_t)state * SIMD_FIND_MAX, dfa->skipCount[state],
+                                    input + *i, length - *i);
+        *i += skip;
+        if (skip >= SIMD_SKIP_MIN) {
+            *misses = 0;
+        } else if (++*misses == SIMD_SKIP_MISSES) {
+            *misses = 0;
+            run = SIMD_SKIP_BACKOFF;
+        }
+    }
+    return length - *i < run ? length - *i : run;
+}
+
+// Run the given DFA from the given state over length bytes of input, and return the
+// state it ends up in, or -1 as soon as it reaches the reject state.
+int DFA_advance(DFA dfa, int state, const uint8_t* input, size_t length){
+    if (state == -1) {
+        return -1;
+    }
+    if (dfa->skipCount == NULL) {
+        return DFA_run(dfa, state, input, length);
+    }
+    size_t i = 0;
+    int misses = 0;
+    while (i < length) {
+        size_t n = DFA_skip(dfa, state, input, length, &i, &misses);
+        state = DFA_run(dfa, state, input + i, n);
+        if (state == -1) {
+            return -1;
+        }
+        i += n;
+    }
+    return state;
+}
+
+// Run the given DFA from *state over at most length bytes of input, stopping just
+// after it enters an accepting state or the reject state. Stores the state reached
+// in *state and returns the number of bytes read.
+size_t DFA_advance_to_accept(DFA dfa, int* state, const uint8_t* input, size_t length){
+    if (*state == -1) {
+        return 0;
+    }
+    if (dfa->skipCount == NULL) {
+        return DFA_run_to_accept(dfa, state, input, length);
+    }
+    size_t i = 0;
+    int misses = 0;
+    while (i < length) {
+        // An accepting state would be entered again on every skipped byte,
+        // so only non-accepting states skip here
+        size_t n = length - i < DFA_SKIP_RUN ? length - i : DFA_SKIP_RUN;
+        if (!DFA_get_accepting(dfa, *state)) {
+            n = DFA_skip(dfa, *state, input, length, &i, &misses);
+        }
+        i += DFA_run_to_accept(dfa, state, input + i, n);
+        if (*state == -1 || DFA_get_accepting(dfa, *state)) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Return true if the given state of the given DFA goes to itself on every input.
+bool DFA_is_absorbing(DFA dfa, int state){
+    if (dfa->skipCount != NULL) {
+        return dfa->skipCount[state] == 0;
+    }
+    for (int cls = 0; cls < dfa->numClasses; cls++) {
+        if (DFA_get_class_transition(dfa, state, cls) != state) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run the given DFA from each of n states over the same length bytes of input in
+// lockstep, replacing each state with the one it ends up in (or -1).
+void DFA_advance_all(DFA dfa, int* states, int n, const uint8_t* input, size_t length){
+    switch (dfa->width) {
+        case 1:
+            DFA_run_all_uint8_t((const uint8_t*)dfa->table, dfa->classes, dfa->numClasses, states, n, input, length);
+            break;
+        case 2:
+            DFA_run_all_uint16_t((const uint16_t*)dfa->table, dfa->classes, dfa->numClasses, states, n, input, length);
+            break;
+        default:
+            DFA_run_all_int32_t((const int32_t*)dfa->table, dfa->classes, dfa->numClasses, states, n, input, length);
+            break;
+    }
+}
+
+// Run the given DFA on length bytes of input (which may contain any byte values,
+// including NUL), and return true if it accepts the input, otherwise false.
+bool DFA_execute_buf(DFA dfa, const uint8_t* input, size_t length){
+    int state = DFA_advance(dfa, dfa->initialState, input, length);
+    return state != -1 && DFA_get_accepting(dfa, state);
+}
+
+// Run the given DFA on each of n inputs, up to DFA_LANES of them at a time in
+// lockstep, and store whether it accepts each one in results.
+void DFA_execute_many(DFA dfa, const uint8_t* const* inputs, const size_t* lengths, int n, bool* results){
+    // A table this small stays in the L1 cache, so there are no misses to
+    // overlap and the bookkeeping would only slow things down
+    if ((size_t)dfa->numStates * dfa->numClasses * dfa->width <= DFA_SMALL_TABLE) {
+        for (int i = 0; i < n; i++) {
+            results[i] = DFA_execute_buf(dfa, inputs[i], lengths[i]);
+        }
+        return;
+    }
+    switch (dfa->width) {
+        case 1:
+            DFA_run_many_uint8_t((const uint8_t*)dfa->table, dfa->classes, dfa->numClasses, dfa->accepting,
+                                 dfa->initialState, inputs, lengths, n, results);
+            break;
+        case 2:
+            DFA_run_many_uint16_t((const uint16_t*)dfa->table, dfa->classes, dfa->numClasses, dfa->accepting,
+                                  dfa->initialState, inputs, lengths, n, results);
+            break;
+        default:
+            DFA_run_many_int32_t((const int32_t*)dfa->table, dfa->classes, dfa->numClasses, dfa->accepting,
+                                 dfa->initialState, inputs, lengths, n, results);
+            break;
+    }
 }
 
 // Run the given DFA on the given input string, and return true if it accepts the input, otherwise false.
 bool DFA_execute(DFA dfa, char *input){
-    int current_state = 0;
-    for (int i = 0; input[i] != '\0'; i++) {
-        char symbol = input[i];
-        current_state = DFA_get_transition(dfa, current_state, symbol);
-        if (current_state == -1) {
-            return false;
+    return DFA_execute_buf(dfa, (const uint8_t*)input, strlen(input));
+}
+
+// State of a DFA run over input that arrives in pieces
+struct DFAStream {
+    DFA dfa;
+    int state;      // Current state, or -1 once the input has been rejected
+};
+
+// Start running the given DFA over a stream of input chunks.
+DFAStream DFA_stream_begin(DFA dfa){
+    DFAStream stream = (DFAStream)malloc(sizeof(struct DFAStream));
+    stream->dfa = dfa;
+    stream->state = dfa->initialState;
+    return stream;
+}
+
+// Continue the given stream with the next length bytes of input. Return false
+// if the input has already been rejected, in which case the rest can be skipped.
+bool DFA_stream_feed(DFAStream stream, const uint8_t* chunk, size_t length){
+    stream->state = DFA_advance(stream->dfa, stream->state, chunk, length);
+    return stream->state != -1;
+}
+
+// Return true if the input fed to the given stream so far is accepted.
+bool DFA_stream_accepting(DFAStream stream){
+    return stream->state != -1 && DFA_get_accepting(stream->dfa, stream->state);
+}
+
+// Finish the given stream, freeing it, and return true if the DFA accepts the input fed to it.
+bool DFA_stream_end(DFAStream stream){
+    bool result = DFA_stream_accepting(stream);
+    free(stream);
+    return result;
+}
+
+// Find the shortest accepted prefix of the given input and store its length in *end.
+bool DFA_first_accept(DFA dfa, const uint8_t* input, size_t length, size_t* end){
+    int state = dfa->initialState;
+    if (DFA_get_accepting(dfa, state)) {
+        *end = 0;
+        return true;
+    }
+    size_t n = DFA_advance_to_accept(dfa, &state, input, length);
+    if (state == -1 || !DFA_get_accepting(dfa, state)) {
+        return false;
+    }
+    *end = n;
+    return true;
+}
+
+// Working space for finding matches, allocated once per search. Runs of the DFA
+// from every start position still in the running are followed together; runs
+// that reach the same state have the same future, so only the one with the
+// earliest start is kept, and there is at most one run per state.
+struct DFAFinder {
+    DFA dfa;
+    int* states;            // States of the runs
+    int* next;              // Double buffer for states
+    size_t* startOf;        // Start of the run in each state, or SIZE_MAX
+    size_t* nextStartOf;    // Double buffer for startOf
+    uint8_t viable[SIMD_FIND_MAX];  // Bytes that don't reject in the initial state,
+    int viableCount;                // if there are few enough of them, or -1
+};
+
+static void DFAFinder_init(struct DFAFinder* f, DFA dfa){
+    f->dfa = dfa;
+    f->states = (int*)malloc(dfa->numStates * sizeof(int));
+    f->next = (int*)malloc(dfa->numStates * sizeof(int));
+    f->startOf = (size_t*)malloc(dfa->numStates * sizeof(size_t));
+    f->nextStartOf = (size_t*)malloc(dfa->numStates * sizeof(size_t));
+    for (int s = 0; s < dfa->numStates; s++) {
+        f->startOf[s] = SIZE_MAX;
+        f->nextStartOf[s] = SIZE_MAX;
+    }
+    f->viableCount = 0;
+    for (int sym = 0; sym < ALPHABET && f->viableCount != -1; sym++) {
+        if (DFA_get_transition(dfa, dfa->initialState, (char)sym) != -1) {
+            if (f->viableCount == SIMD_FIND_MAX) {
+                f->viableCount = -1;
+            } else {
+                f->viable[f->viableCount++] = (uint8_t)sym;
+            }
+        }
+    }
+}
+
+static void DFAFinder_free(struct DFAFinder* f){
+    free(f->states);
+    free(f->next);
+    free(f->startOf);
+    free(f->nextStartOf);
+}
+
+// Find the leftmost-longest match starting at or after from.
+static bool DFAFinder_find(struct DFAFinder* f, const uint8_t* input, size_t length, size_t from, Match* match){
+    DFA dfa = f->dfa;
+    int initial = dfa->initialState;
+    bool initialAccepting = DFA_get_accepting(dfa, initial);
+    int n = 0;
+    bool found = false;
+    for (size_t i = from; ; i++) {
+        if (!found) {
+            // With no runs left, a match can only start at a byte the initial state doesn't reject
+            if (n == 0 && !initialAccepting && f->viableCount != -1) {
+                i += SIMD_find_any(f->viable, f->viableCount, input + i, length - i);
+            }
+            // Start a run here, unless one that started earlier is already in the initial state
+            if (f->startOf[initial] == SIZE_MAX) {
+                f->startOf[initial] = i;
+                f->states[n++] = initial;
+            }
+        }
+        // Runs in accepting states end matches here
+        for (int k = 0; k < n; k++) {
+            int s = f->states[k];
+            size_t start = f->startOf[s];
+            if (DFA_get_accepting(dfa, s) && (!found || start < match->start || (start == match->start && i > match->end))) {
+                match->start = start;
+                match->end = i;
+                found = true;
+            }
+        }
+        if (found) {
+            // Runs that started after the match can't beat it
+            int kept = 0;
+            for (int k = 0; k < n; k++) {
+                int s = f->states[k];
+                if (f->startOf[s] <= match->start) {
+                    f->states[kept++] = s;
+                } else {
+                    f->startOf[s] = SIZE_MAX;
+                }
+            }
+            n = kept;
+            // The match's own run can't leave its state: it goes on to the end
+            if (n == 1 && match->end == i && DFA_is_absorbing(dfa, f->states[0])) {
+                match->end = length;
+                break;
+            }
         }
+        if (n == 0 || i == length) {
+            break;
+        }
+        // Step every run over input[i]
+        int cls = dfa->classes[input[i]];
+        int m = 0;
+        for (int k = 0; k < n; k++) {
+            int s = f->states[k];
+            size_t start = f->startOf[s];
+            f->startOf[s] = SIZE_MAX;
+            int t = DFA_get_class_transition(dfa, s, cls);
+            if (t == -1) {
+                continue;
+            }
+            if (f->nextStartOf[t] == SIZE_MAX) {
+                f->next[m++] = t;
+                f->nextStartOf[t] = start;
+            } else if (start < f->nextStartOf[t]) {
+                f->nextStartOf[t] = start;
+            }
+        }
+        int* states = f->states;
+        f->states = f->next;
+        f->next = states;
+        size_t* startOf = f->startOf;
+        f->startOf = f->nextStartOf;
+        f->nextStartOf = startOf;
+        n = m;
+    }
+    for (int k = 0; k < n; k++) {
+        f->startOf[f->states[k]] = SIZE_MAX;
     }
-    return DFA_get_accepting(dfa, current_state);
+    return found;
+}
+
+// Find the leftmost-longest match in the given input.
+bool DFA_find(DFA dfa, const uint8_t* input, size_t length, Match* match){
+    struct DFAFinder finder;
+    DFAFinder_init(&finder, dfa);
+    bool found = DFAFinder_find(&finder, input, length, 0, match);
+    DFAFinder_free(&finder);
+    return found;
+}
+
+// Call func on each non-overlapping leftmost-longest match in the given input
+// and return the number of matches.
+size_t DFA_find_all(DFA dfa, const uint8_t* input, size_t length, MatchCallback func, void* ctx){
+    struct DFAFinder finder;
+    DFAFinder_init(&finder, dfa);
+    size_t count = 0;
+    size_t from = 0;
+    Match match;
+    while (from <= length && DFAFinder_find(&finder, input, length, from, &match)) {
+        count += 1;
+        if (!func(match, ctx)) {
+            break;
+        }
+        from = match.end > match.start ? match.end : match.end + 1;
+    }
+    DFAFinder_free(&finder);
+    return count;
+}
+
+// Destination for DFA_find_all_array
+struct MatchArray {
+    Match* matches;
+    size_t count;
+    size_t max;
+};
+
+static bool store_match(Match match, void* ctx){
+    struct MatchArray* array = (struct MatchArray*)ctx;
+    array->matches[array->count++] = match;
+    return array->count < array->max;
+}
+
+// Store the first max non-overlapping leftmost-longest matches in matches and
+// return how many there were.
+size_t DFA_find_all_array(DFA dfa, const uint8_t* input, size_t length, Match* matches, size_t max){
+    struct MatchArray array = { matches, 0, max };
+    if (max > 0) {
+        DFA_find_all(dfa, input, length, store_match, &array);
+    }
+    return array.count;
 }
 
 // Runs any DFA in a “Read-Eval-Print Loop” (REPL)
+// Lines of any length are read in pieces and fed to a DFAStream as they arrive.
 void DFA_repl(DFA *dfa) {
     while (1) {
         char input[51];
+        char shown[51];     // Start of the line, for echoing it back
         printf("\tEnter Input (\"quit\" to Quit): ");
-        if (fgets(input, sizeof(input), stdin) == NULL) {
+        DFAStream stream = DFA_stream_begin(*dfa);
+        bool first = true;
+        bool complete = false;
+        bool quit = false;
+        bool whole = true;  // Whether the line fit in the first piece (the rest is at most its newline)
+        while (!complete && fgets(input, sizeof(input), stdin) != NULL) {
+            size_t length = strcspn(input, "\n");
+            complete = input[length] == '\n';
+            if (first) {
+                memcpy(shown, input, length);
+                shown[length] = '\0';
+                quit = complete && strcmp(shown, "quit") == 0;
+            } else if (length > 0) {
+                whole = false;
+            }
+            DFA_stream_feed(stream, (const uint8_t*)input, length);
+            first = false;
+        }
+        bool result = DFA_stream_end(stream);
+        if (first) {
             printf("Error reading input\n");
             break;
         }
-        input[strcspn(input, "\n")] = '\0';
-        if (strcmp(input, "quit") == 0) {
+        if (quit) {
             break;
         }
-        bool result = DFA_execute(*dfa, input);
-        printf("\tResult for \"%s\": %s\n", input, result ? "true" : "false");
+        printf("\tResult for \"%s%s\": %s\n", shown, whole ? "" : "...",
+               result ? "true" : "false");
     }
     printf("\n");
 }
 
+// Files. A saved DFA is a fixed-size header followed by sections, each
+// starting on an 8-byte boundary so it can be used in place once the file
+// is mapped:
+//  - the transition table, exactly as it is in memory
+//  - the accept bitmap
+//  - the skip counts and skip bytes (if any state can skip)
+//  - the pattern set id of each state (if any state is tagged)
+//  - the pattern sets: their count, then for each its size and its ids
+// The header holds what a DFA needs besides those arrays (the class map
+// among them), where each section is, and a checksum of everything after
+// the header. Numbers are stored in the byte order of the machine that
+// wrote them; a file from a machine with the other order is rejected rather
+// than converted. The shuffle vectors are cheap to rebuild, so they aren't
+// saved, and the pattern sets are interned again when the file is loaded.
+
+#define DFA_FILE_MAGIC "CSC173DF"
+#define DFA_FILE_VERSION 1
+#define DFA_FILE_BYTE_ORDER 0x01020304u
+#define DFA_FILE_PREPARED 1         // Flag: the skip sections are up to date (and absent if no state can skip)
+
+enum {
+    DFA_SECTION_TABLE,
+    DFA_SECTION_ACCEPTING,
+    DFA_SECTION_SKIP_COUNT,
+    DFA_SECTION_SKIP_BYTES,
+    DFA_SECTION_PATTERN_SET,
+    DFA_SECTION_PATTERNS,
+    DFA_SECTIONS
+};
+
+struct DFAFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         // DFA_FILE_BYTE_ORDER, as the writer stored it
+    uint32_t numStates;
+    uint32_t numClasses;
+    uint32_t width;
+    int32_t initialState;
+    uint32_t findMax;           // SIMD_FIND_MAX of the writer (the skip sections depend on it)
+    uint32_t flags;
+    uint64_t size;              // Of the whole file
+    uint64_t checksum;          // Of everything after the header
+    uint64_t offset[DFA_SECTIONS];  // From the start of the file
+    uint64_t length[DFA_SECTIONS];  // In bytes; 0 if the section is left out
+    uint8_t classes[ALPHABET];
+};
+
+// Round the given size up to a multiple of 8
+static size_t DFA_align(size_t size){
+    return (size + 7) & ~(size_t)7;
+}
+
+// Return the FNV-1a hash of the given data, taken 8 bytes at a time (length
+// must be a multiple of 8).
+static uint64_t DFA_checksum(const uint8_t* data, size_t length){
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Save the given DFA to the file at the given path, in the format described above.
+int DFA_save(DFA dfa, const char* path){
+    size_t n = dfa->numStates;
+    const void* sections[DFA_SECTIONS] = { NULL };
+    size_t length[DFA_SECTIONS] = { 0 };
+    sections[DFA_SECTION_TABLE] = dfa->table;
+    length[DFA_SECTION_TABLE] = n * dfa->numClasses * dfa->width;
+    sections[DFA_SECTION_ACCEPTING] = dfa->accepting;
+    length[DFA_SECTION_ACCEPTING] = (n + 7) / 8;
+    if (dfa->prepared && dfa->skipCount != NULL) {
+        sections[DFA_SECTION_SKIP_COUNT] = dfa->skipCount;
+        length[DFA_SECTION_SKIP_COUNT] = n;
+        sections[DFA_SECTION_SKIP_BYTES] = dfa->skipBytes;
+        length[DFA_SECTION_SKIP_BYTES] = n * SIMD_FIND_MAX;
+    }
+    int32_t* patterns = NULL;
+    if (dfa->patterns != NULL) {
+        int count = SubsetMap_count(dfa->patterns);
+        size_t size = 1;
+        for (int id = 0; id < count; id++) {
+            int k;
+            SubsetMap_get(dfa->patterns, id, &k);
+            size += 1 + k;
+        }
+        patterns = (int32_t*)malloc(size * sizeof(int32_t));
+        size_t at = 0;
+        patterns[at++] = count;
+        for (int id = 0; id < count; id++) {
+            int k;
+            const int* ids = SubsetMap_get(dfa->patterns, id, &k);
+            patterns[at++] = k;
+            for (int i = 0; i < k; i++) {
+                patterns[at++] = ids[i];
+            }
+        }
+        sections[DFA_SECTION_PATTERN_SET] = dfa->patternSet;
+        length[DFA_SECTION_PATTERN_SET] = n * sizeof(int);
+        sections[DFA_SECTION_PATTERNS] = patterns;
+        length[DFA_SECTION_PATTERNS] = size * sizeof(int32_t);
+    }
+
+    struct DFAFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DFA_FILE_MAGIC, sizeof(header.magic));
+    header.version = DFA_FILE_VERSION;
+    header.byteOrder = DFA_FILE_BYTE_ORDER;
+    header.numStates = (uint32_t)n;
+    header.numClasses = (uint32_t)dfa->numClasses;
+    header.width = (uint32_t)dfa->width;
+    header.initialState = dfa->initialState;
+    header.findMax = SIMD_FIND_MAX;
+    header.flags = dfa->prepared ? DFA_FILE_PREPARED : 0;
+    memcpy(header.classes, dfa->classes, ALPHABET);
+    size_t size = DFA_align(sizeof(header));
+    for (int s = 0; s < DFA_SECTIONS; s++) {
+        header.offset[s] = length[s] > 0 ? size : 0;
+        header.length[s] = length[s];
+        size += DFA_align(length[s]);
+    }
+    header.size = size;
+
+    uint8_t* data = (uint8_t*)calloc(size, 1);     // Zeroes the padding, which is checksummed too
+    for (int s = 0; s < DFA_SECTIONS; s++) {
+        if (length[s] > 0) {
+            memcpy(data + header.offset[s], sections[s], length[s]);
+        }
+    }
+    free(patterns);
+    size_t start = DFA_align(sizeof(header));
+    header.checksum = DFA_checksum(data + start, size - start);
+    memcpy(data, &header, sizeof(header));
+
+    // Written under another name and renamed into place, so a process that
+    // has the old file mapped keeps seeing all of the old file
+    char* temp = (char*)malloc(strlen(path) + 5);
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+    FILE* file = fopen(temp, "wb");
+    bool written = file != NULL && fwrite(data, 1, size, file) == size;
+    if (file != NULL && fclose(file) != 0) {
+        written = false;
+    }
+    free(data);
+    if (!written || rename(temp, path) != 0) {
+        perror(path);
+        remove(temp);
+        free(temp);
+        return -1;
+    }
+    free(temp);
+    return 0;
+}
+
+// Return an error message if the given header doesn't describe a DFA file of
+// the given size, otherwise NULL.
+static const char* DFA_check_header(const struct DFAFileHeader* header, size_t size){
+    if (memcmp(header->magic, DFA_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        return "not a DFA file";
+    }
+    if (header->byteOrder != DFA_FILE_BYTE_ORDER) {
+        return "DFA file written with another byte order";
+    }
+    if (header->version != DFA_FILE_VERSION) {
+        return "unsupported DFA file version";
+    }
+    if (header->size != size) {
+        return "DFA file size does not match its header";
+    }
+    uint64_t n = header->numStates;
+    if (n > INT32_MAX || header->numClasses < 1 || header->numClasses > ALPHABET
+        || (header->width != 1 && header->width != 2 && header->width != 4)
+        || header->width < (uint32_t)DFA_width_for((int)n)
+        || header->initialState < 0 || (uint64_t)header->initialState >= n) {
+        return "bad DFA file header";
+    }
+    for (int sym = 0; sym < ALPHABET; sym++) {
+        if (header->classes[sym] >= header->numClasses) {
+            return "bad DFA file header";
+        }
+    }
+    uint64_t expected[DFA_SECTIONS] = {
+        n * header->numClasses * header->width, (n + 7) / 8,
+        n, n * header->findMax, n * sizeof(int), 0
+    };
+    for (int s = 0; s < DFA_SECTIONS; s++) {
+        uint64_t offset = header->offset[s];
+        uint64_t length = header->length[s];
+        if (length == 0) {
+            continue;
+        }
+        if (offset % 8 != 0 || offset < sizeof(*header) || offset > size || length > size - offset
+            || (s != DFA_SECTION_PATTERNS && length != expected[s])) {
+            return "bad DFA file section";
+        }
+    }
+    if (header->length[DFA_SECTION_TABLE] != expected[DFA_SECTION_TABLE]
+        || header->length[DFA_SECTION_ACCEPTING] != expected[DFA_SECTION_ACCEPTING]
+        || (header->length[DFA_SECTION_SKIP_COUNT] == 0) != (header->length[DFA_SECTION_SKIP_BYTES] == 0)
+        || (header->length[DFA_SECTION_PATTERN_SET] == 0) != (header->length[DFA_SECTION_PATTERNS] == 0)) {
+        return "bad DFA file section";
+    }
+    return NULL;
+}
+
+// Intern the pattern sets stored in the given section (of the given length in
+// bytes) into the given DFA, returning false if they aren't well formed.
+static bool DFA_load_patterns(DFA dfa, const int32_t* section, size_t length){
+    size_t size = length / sizeof(int32_t);
+    if (size < 1 || section[0] < 1) {
+        return false;
+    }
+    int count = section[0];
+    dfa->patterns = new_SubsetMap(16);
+    size_t at = 1;
+    for (int id = 0; id < count; id++) {
+        if (at >= size || section[at] < 0 || (size_t)section[at] > size - at - 1) {
+            return false;
+        }
+        int k = section[at++];
+        bool added;
+        int none = 0;
+        const int* ids = k > 0 ? (const int*)(section + at) : &none;
+        if (SubsetMap_intern(dfa->patterns, ids, k, &added) != id || !added || (id == 0) != (k == 0)) {
+            return false;
+        }
+        at += k;
+    }
+    for (int state = 0; state < dfa->numStates; state++) {
+        if (dfa->patternSet[state] < 0 || dfa->patternSet[state] >= count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Load and return a DFA saved by DFA_save, with its arrays mapped from the file.
+DFA DFA_load(const char* path){
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < sizeof(struct DFAFileHeader)) {
+        fprintf(stderr, "%s: not a DFA file\n", path);
+        close(fd);
+        return NULL;
+    }
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+    const uint8_t* data = (const uint8_t*)mapping;
+    struct DFAFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    const char* error = DFA_check_header(&header, size);
+    size_t start = DFA_align(sizeof(header));
+    if (error == NULL && DFA_checksum(data + start, size - start) != header.checksum) {
+        error = "DFA file checksum does not match";
+    }
+    if (error != NULL) {
+        fprintf(stderr, "%s: %s\n", path, error);
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    // The const is cast away, but DFA_own copies each of these before anything writes to it
+    DFA dfa = (DFA)malloc(sizeof(struct DFA));
+    dfa->mapping = mapping;
+    dfa->mappingSize = size;
+    dfa->numStates = (int)header.numStates;
+    dfa->capacity = dfa->numStates;
+    dfa->initialState = header.initialState;
+    memcpy(dfa->classes, header.classes, ALPHABET);
+    dfa->numClasses = (int)header.numClasses;
+    dfa->width = (int)header.width;
+    dfa->table = (void*)(data + header.offset[DFA_SECTION_TABLE]);
+    dfa->accepting = (uint8_t*)(data + header.offset[DFA_SECTION_ACCEPTING]);
+    dfa->shuffle = NULL;
+    dfa->shuffleDead = -1;
+    dfa->skipCount = NULL;
+    dfa->skipBytes = NULL;
+    dfa->patterns = NULL;
+    dfa->patternSet = NULL;
+    if (header.length[DFA_SECTION_PATTERN_SET] > 0) {
+        dfa->patternSet = (int*)(data + header.offset[DFA_SECTION_PATTERN_SET]);
+    }
+
+    // Every entry must be a state or the reject state, or a run could leave the table
+    bool valid = true;
+    size_t entries = (size_t)dfa->numStates * dfa->numClasses;
+    for (size_t i = 0; i < entries && valid; i++) {
+        int dst = DFA_entry(dfa->table, dfa->width, i);
+        valid = dst >= -1 && dst < dfa->numStates;
+    }
+    if (valid && dfa->patternSet != NULL) {
+        valid = DFA_load_patterns(dfa, (const int32_t*)(data + header.offset[DFA_SECTION_PATTERNS]),
+                                  header.length[DFA_SECTION_PATTERNS]);
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: bad DFA file contents\n", path);
+        DFA_free(dfa);
+        return NULL;
+    }
+
+    // Use the saved skip arrays if they were made for the same SIMD_FIND_MAX
+    bool skipSaved = (header.flags & DFA_FILE_PREPARED) && header.findMax == SIMD_FIND_MAX;
+    if (skipSaved && header.length[DFA_SECTION_SKIP_COUNT] > 0) {
+        dfa->skipCount = (int8_t*)(data + header.offset[DFA_SECTION_SKIP_COUNT]);
+        dfa->skipBytes = (uint8_t*)(data + header.offset[DFA_SECTION_SKIP_BYTES]);
+        for (int state = 0; state < dfa->numStates && valid; state++) {
+            valid = dfa->skipCount[state] >= -1 && dfa->skipCount[state] <= SIMD_FIND_MAX;
+        }
+        if (!valid) {
+            dfa->skipCount = NULL;
+            dfa->skipBytes = NULL;
+            skipSaved = false;
+        }
+    }
+    if (!skipSaved) {
+        DFA_build_skip(dfa);
+    }
+    DFA_build_shuffle(dfa);
+    dfa->prepared = true;
+    return dfa;
+}
+
 // Prints dfa
 void DFA_print(DFA dfa){
     printf("States: ");
     for (int i = 0; i < dfa->numStates; i++) {
         printf("%d ", i);
     }
-    printf("\nInput Alphabet: ASCII Characters 1-128\nTransition Table:\n");
+    printf("\nInput Alphabet: Bytes 0-255 in %d classes\n", dfa->numClasses);
+    for (int cls = 0; cls < dfa->numClasses; cls++) {
+        printf("Class %d [", cls);
+        for (int sym = 0; sym < ALPHABET; sym++) {
+            if (dfa->classes[sym] == cls) {
+                if (sym > ' ' && sym < 127) {
+                    printf("%c", sym);
+                } else {
+                    printf("\\x%02x", sym);
+                }
+            }
+        }
+        printf("]\n");
+    }
+    printf("Transition Table (by class):\n");
     for (int i = 0; i < dfa->numStates; i++) {
         printf("State %d [", i);
-        for (int j = 0; j < 128; j++) {
-            printf("%d ", dfa->transitions[i][j]);
+        for (int j = 0; j < dfa->numClasses; j++) {
+            printf("%d ", DFA_get_class_transition(dfa, i, j));
         }
         printf("]\n");
     }
-    printf("Initial State: 0\nAccepting States:\n");
+    printf("Initial State: %d\nAccepting States:\n", dfa->initialState);
     for (int i = 0; i < dfa->numStates; i++) {
-        if (dfa->acceptingStates[i] == 1) {
+        if (DFA_get_accepting(dfa, i)) {
             printf("%d\n", i);
         }
     }
@@ -153,6 +1485,7 @@ DFA* DFA_for_contains_dfa(){
     DFA_set_transition(*dfa, 1, 'f', 2);
     DFA_set_transition(*dfa, 2, 'a', 3);
     DFA_set_accepting(*dfa, 3, true);
+    DFA_compress(*dfa);
     return dfa;
 }
 
@@ -165,6 +1498,7 @@ DFA* DFA_for_contains_cat(){
     DFA_set_transition(*dfa, 2, 't', 3);
     DFA_set_transition_all(*dfa, 3, 3);
     DFA_set_accepting(*dfa, 3, true);
+    DFA_compress(*dfa);
     return dfa;
 }
 
@@ -174,7 +1508,7 @@ DFA* DFA_for_contains_two2(){
     *dfa = new_DFA(3);
     DFA_set_transition(*dfa, 0, '2', 1);
     DFA_set_transition(*dfa, 1, '2', 2);
-    for (int sym = 0; sym < 128; sym++) {
+    for (int sym = 0; sym < ALPHABET; sym++) {
         if (sym != '2') {
             DFA_set_transition(*dfa, 0, (char)sym, 0);
             DFA_set_transition(*dfa, 1, (char)sym, 1);
@@ -182,6 +1516,7 @@ DFA* DFA_for_contains_two2(){
         }
     }
     DFA_set_accepting(*dfa, 2, true);
+    DFA_compress(*dfa);
     return dfa;
 }
 
@@ -198,6 +1533,7 @@ DFA* DFA_for_contains_evenOdd(){
     DFA_set_transition(*dfa, 3, '0', 1);
     DFA_set_transition(*dfa, 3, '1', 2);
     DFA_set_accepting(*dfa, 1, true);
+    DFA_compress(*dfa);
     return dfa;
 }
 
@@ -8,6 +8,14 @@
 #define _dfa_h
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "match.h"
+
+/**
+ * Number of input symbols: DFAs run over arbitrary bytes.
+ */
+#define DFA_ALPHABET_SIZE 256
 
 /**
  * The data structure used to represent a deterministic finite automaton.
@@ -23,11 +31,25 @@ typedef struct DFA *DFA;
  */
 extern DFA new_DFA(int nstates);
 
+/**
+ * Allocate and return a new DFA containing the given number of states,
+ * whose input symbols are grouped into nclasses equivalence classes:
+ * classes[sym] is the class (0 to nclasses-1) of each of the 256 symbols.
+ * Transitions can then be set a class at a time.
+ */
+extern DFA new_DFA_classes(int nstates, const unsigned char* classes, int nclasses);
+
 /**
  * Free the given DFA.
  */
 extern void DFA_free(DFA dfa);
 
+/**
+ * Add a new state to the given DFA and return its index. The new state is
+ * non-accepting and all of its transitions reject.
+ */
+extern int DFA_add_state(DFA dfa);
+
 /**
  * Return the number of states in the given DFA.
  */
@@ -45,6 +67,44 @@ extern int DFA_get_transition(DFA dfa, int src, char sym);
  */
 extern void DFA_set_transition(DFA dfa, int src, char sym, int dst);
 
+/**
+ * Return the number of input symbol classes in the given DFA (the length
+ * of each row of its transition table).
+ */
+extern int DFA_get_num_classes(DFA dfa);
+
+/**
+ * Return the class of input symbol sym in the given DFA.
+ */
+extern int DFA_get_class(DFA dfa, char sym);
+
+/**
+ * Return the state the given DFA moves to from state src on the symbols
+ * in class cls.
+ */
+extern int DFA_get_class_transition(DFA dfa, int src, int cls);
+
+/**
+ * For the given DFA, set the transition from state src on every symbol in
+ * class cls to be the state dst.
+ */
+extern void DFA_set_class_transition(DFA dfa, int src, int cls, int dst);
+
+/**
+ * Merge input symbols that every state of the given DFA treats the same
+ * way into a single class, shrinking the transition table to one entry per
+ * class, and return the number of classes. Call this once the DFA is built;
+ * setting a single symbol's transition afterwards undoes the compression.
+ */
+extern int DFA_compress(DFA dfa);
+
+/**
+ * Build the faster ways of running the given DFA that DFA_compress builds,
+ * if they aren't built already. Running a DFA never builds anything, so
+ * once this is done it can be run by several threads at once.
+ */
+extern void DFA_prepare(DFA dfa);
+
 /**
  * Set the transitions of the given DFA for each symbol in the given str.
  * This is a nice shortcut when you have multiple labels on an edge between
@@ -68,12 +128,173 @@ extern void DFA_set_accepting(DFA dfa, int state, bool value);
  */
 extern bool DFA_get_accepting(DFA dfa, int state);
 
+/**
+ * Tag the given state with a set of pattern ids (the n sorted, distinct ids
+ * in ids), as NFA_union_to_DFA does for the patterns each state matches.
+ * States start out with no pattern ids.
+ */
+extern void DFA_set_patterns(DFA dfa, int state, const int* ids, int n);
+
+/**
+ * Return the sorted pattern ids the given state is tagged with, and store
+ * how many there are in n. The array belongs to the DFA and is only valid
+ * until the next call to DFA_set_patterns.
+ */
+extern const int* DFA_get_patterns(DFA dfa, int state, int* n);
+
+/**
+ * Return a number identifying the given state's set of pattern ids: two
+ * states of the same DFA have the same number exactly when they have the
+ * same set. States with no pattern ids have 0.
+ */
+extern int DFA_get_pattern_set(DFA dfa, int state);
+
+/**
+ * Run the given DFA on length bytes of input and return the pattern ids of
+ * the state it ends in, storing how many there are in n (0 if the input is
+ * rejected). For a DFA built by NFA_union_to_DFA that is every pattern that
+ * accepts the input, found in one pass however many patterns there are.
+ */
+extern const int* DFA_execute_patterns(DFA dfa, const uint8_t* input, size_t length, int* n);
+
 /**
  * Run the given DFA on the given input string, and return true if it accepts
  * the input, otherwise false.
  */
 extern bool DFA_execute(DFA dfa, char *input);
 
+/**
+ * Run the given DFA from its initial state on the given length bytes of
+ * input, which may hold any byte values (including NUL), and return true if
+ * it accepts the input, otherwise false. Stops reading as soon as the input
+ * can no longer be accepted.
+ */
+extern bool DFA_execute_buf(DFA dfa, const uint8_t* input, size_t length);
+
+/**
+ * Run the given DFA from its initial state on each of the n inputs (inputs[i]
+ * is lengths[i] bytes long) and set results[i] to whether it accepts input
+ * i. Up to DFA_LANES inputs are run at a time in lockstep, one byte of each
+ * per step, so that their table loads overlap instead of each waiting on
+ * the one before it. A lane that finishes its input picks up the next one.
+ * Much faster than one DFA_execute_buf after another for batches of short
+ * inputs on a DFA whose table doesn't fit in the L1 cache (for one that
+ * does, the inputs are simply run one after another).
+ */
+extern void DFA_execute_many(DFA dfa, const uint8_t* const* inputs, const size_t* lengths,
+                             int n, bool* results);
+
+#define DFA_LANES 8
+
+/**
+ * A DFAStream runs a DFA over input that arrives in chunks (socket reads,
+ * blocks of a file), carrying its state from one chunk to the next so the
+ * input never has to be gathered into one buffer. Chunks are read in place.
+ */
+typedef struct DFAStream* DFAStream;
+
+/**
+ * Start running the given DFA over a stream of input chunks. The DFA must
+ * not be modified or freed until the stream is ended.
+ */
+extern DFAStream DFA_stream_begin(DFA dfa);
+
+/**
+ * Continue the given stream with the next length bytes of input. Returns
+ * false once the input can no longer be accepted, so the caller may stop
+ * feeding it.
+ */
+extern bool DFA_stream_feed(DFAStream stream, const uint8_t* chunk, size_t length);
+
+/**
+ * Return true if the input fed to the given stream so far is accepted.
+ */
+extern bool DFA_stream_accepting(DFAStream stream);
+
+/**
+ * Finish and free the given stream, returning true if the DFA accepts all
+ * the input that was fed to it.
+ */
+extern bool DFA_stream_end(DFAStream stream);
+
+/**
+ * Run the given DFA from the given state over length bytes of input and
+ * return the state it ends in, or -1 (the reject state) as soon as it gets
+ * there. Passing -1 as the state returns -1. DFAs with at most 16 states
+ * are run with SIMD byte shuffles where the CPU supports them, states that
+ * only a few bytes lead out of skip ahead to the next of those bytes, and
+ * the run stops early in a state that can't be left.
+ */
+extern int DFA_advance(DFA dfa, int state, const uint8_t* input, size_t length);
+
+/**
+ * Return true if the given state of the given DFA goes to itself on every
+ * input symbol, so that once there the outcome of the run is settled.
+ */
+extern bool DFA_is_absorbing(DFA dfa, int state);
+
+/**
+ * Like DFA_advance, but stop right after the DFA enters an accepting state
+ * (or the reject state). The state is passed in and returned through
+ * *state, and the number of bytes read is returned.
+ */
+extern size_t DFA_advance_to_accept(DFA dfa, int* state, const uint8_t* input, size_t length);
+
+/**
+ * Run the given DFA over the same length bytes of input from each of the n
+ * states in states[] at once, replacing each with the state it ends in (or
+ * -1). The runs are interleaved byte by byte, so for a handful of states
+ * this costs little more than a single DFA_advance.
+ */
+extern void DFA_advance_all(DFA dfa, int* states, int n, const uint8_t* input, size_t length);
+
+/**
+ * Find the shortest prefix of the given input that the DFA accepts, and
+ * store its length in *end. Returns false if no prefix is accepted.
+ */
+extern bool DFA_first_accept(DFA dfa, const uint8_t* input, size_t length, size_t* end);
+
+/**
+ * Find the leftmost-longest match in the given input: of the parts of the
+ * input that the DFA accepts, the one that starts first, and of those the
+ * longest. Returns false if there is none. Takes one pass over the input
+ * whatever the DFA, following at most one run per DFA state.
+ */
+extern bool DFA_find(DFA dfa, const uint8_t* input, size_t length, Match* match);
+
+/**
+ * Call the given function on each of the non-overlapping leftmost-longest
+ * matches in the given input, in order (after each match, the search
+ * continues from its end, or one byte further for an empty match). Returns
+ * the number of matches. Nothing is allocated per match.
+ */
+extern size_t DFA_find_all(DFA dfa, const uint8_t* input, size_t length, MatchCallback func, void* ctx);
+
+/**
+ * Like DFA_find_all, but store the first max matches in the given array.
+ * Returns the number stored.
+ */
+extern size_t DFA_find_all_array(DFA dfa, const uint8_t* input, size_t length, Match* matches, size_t max);
+
+/**
+ * Save the given DFA to the file at the given path, so DFA_load can use it
+ * without building it again. Returns 0, or -1 (after printing an error
+ * message) if the file can't be written. The file is written under a
+ * temporary name and renamed into place, so processes that have the old
+ * file loaded are not disturbed.
+ */
+extern int DFA_save(DFA dfa, const char* path);
+
+/**
+ * Load and return a DFA saved by DFA_save, or return NULL (after printing
+ * an error message) if the file can't be read, was saved by an incompatible
+ * version or machine, or fails its checksum. The transition table and other
+ * per-state arrays are not copied: they are used where they lie in the
+ * mapped file, so processes that load the same file share its memory. The
+ * first change to the DFA copies them to the heap.
+ */
+extern DFA DFA_load(const char* path);
+
 /**
  * Print the given DFA to System.out.
  */
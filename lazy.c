@@ -0,0 +1,218 @@
+//
+// File: lazy.c
+// Created: 10/17/2026
+//
+// Subset construction on demand. Cached states are interned in a SubsetMap
+// and worked out with the same steps as in NFA_to_DFA (see translate.h), and
+// each has a row of next states (one per input class) that starts out
+// unknown. A run follows the rows as long as they are filled in; an unknown
+// entry is worked out from the NFA, adding the next subset as a new state if
+// it isn't cached yet. When a new state would take the cache over its
+// budget, everything is thrown away and the cache starts again with just the
+// state the run is moving to.
+//
+// If the cache fills up again after only a few bytes per state it built,
+// the input keeps leading to new subsets and working them out costs far
+// more than stepping the NFA, so the rest of that run is handed to the NFA
+// (an NFAStream started from the current subset) instead.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lazy.h"
+#include "SubsetMap.h"
+#include "translate.h"
+
+// Table entries besides state numbers
+#define LAZY_REJECT (-1)    // The empty subset
+#define LAZY_UNKNOWN (-2)   // Not worked out yet
+
+// Estimated bytes each cached state takes in the SubsetMap, besides its NFA states
+#define LAZY_STATE_OVERHEAD (5 * sizeof(int))
+
+// A run that fills the cache after fewer input bytes than this per cached
+// state is finished on the NFA
+#define LAZY_MIN_PROGRESS 10
+
+struct LazyDFA {
+    NFA nfa;
+    int nfaSize;
+    uint8_t classes[NFA_ALPHABET_SIZE];     // Class of each input symbol
+    char representative[NFA_ALPHABET_SIZE]; // A symbol of each class
+    int numClasses;
+    size_t budget;
+    size_t bytes;           // Estimated memory used by the cached states
+    SubsetMap subsets;      // Subset of each cached state
+    int* table;             // Next state for (state, class), or LAZY_REJECT or LAZY_UNKNOWN
+    bool* accepting;        // Whether each cached state is accepting
+    int capacity;           // Rows allocated in table
+    int initial;            // Cached initial state, or -1
+    int* key;               // Scratch subsets
+    int* current;
+    size_t progress;        // Input bytes run since the last flush
+    int flushedStates;      // States thrown away by the last flush
+    long hits;
+    long misses;
+    long flushes;
+    long fallbacks;
+};
+
+LazyDFA new_LazyDFA(NFA nfa, size_t budget) {
+    LazyDFA this = (LazyDFA)malloc(sizeof(struct LazyDFA));
+    this->nfa = nfa;
+    this->nfaSize = NFA_get_size(nfa);
+    unsigned char classes[NFA_ALPHABET_SIZE];
+    this->numClasses = NFA_get_classes(nfa, classes);
+    for (int sym = NFA_ALPHABET_SIZE - 1; sym >= 0; sym--) {
+        this->classes[sym] = classes[sym];
+        this->representative[classes[sym]] = (char)sym;
+    }
+    this->budget = budget;
+    this->bytes = 0;
+    this->subsets = new_SubsetMap(64);
+    this->capacity = 64;
+    this->table = (int*)malloc((size_t)this->capacity * this->numClasses * sizeof(int));
+    this->accepting = (bool*)malloc(this->capacity * sizeof(bool));
+    this->initial = -1;
+    this->key = (int*)malloc(this->nfaSize * sizeof(int));
+    this->current = (int*)malloc(this->nfaSize * sizeof(int));
+    this->hits = 0;
+    this->misses = 0;
+    this->progress = 0;
+    this->flushedStates = 0;
+    this->flushes = 0;
+    this->fallbacks = 0;
+    return this;
+}
+
+void LazyDFA_free(LazyDFA this) {
+    SubsetMap_free(this->subsets);
+    free(this->table);
+    free(this->accepting);
+    free(this->key);
+    free(this->current);
+    free(this);
+}
+
+// Throw away every cached state
+static void LazyDFA_flush(LazyDFA this) {
+    this->flushedStates = SubsetMap_count(this->subsets);
+    SubsetMap_free(this->subsets);
+    this->subsets = new_SubsetMap(64);
+    this->bytes = 0;
+    this->initial = -1;
+    this->flushes += 1;
+}
+
+// Return the cached state for the n sorted NFA states in key, adding it (and
+// flushing the cache first if it is full) if it isn't there yet.
+static int LazyDFA_state(LazyDFA this, const int* key, int n) {
+    int state = SubsetMap_lookup(this->subsets, key, n);
+    if (state != -1) {
+        return state;
+    }
+    size_t cost = (size_t)this->numClasses * sizeof(int) + sizeof(bool)
+                  + n * sizeof(int) + LAZY_STATE_OVERHEAD;
+    if (this->bytes + cost > this->budget && SubsetMap_count(this->subsets) > 0) {
+        LazyDFA_flush(this);
+    }
+    state = SubsetMap_intern(this->subsets, key, n, NULL);
+    if (state == this->capacity) {
+        this->capacity *= 2;
+        this->table = (int*)realloc(this->table, (size_t)this->capacity * this->numClasses * sizeof(int));
+        this->accepting = (bool*)realloc(this->accepting, this->capacity * sizeof(bool));
+    }
+    for (int cls = 0; cls < this->numClasses; cls++) {
+        this->table[(size_t)state * this->numClasses + cls] = LAZY_UNKNOWN;
+    }
+    this->accepting[state] = NFA_subset_accepting(this->nfa, key, n);
+    this->bytes += cost;
+    return state;
+}
+
+// Work out where the given state goes on the given class and cache it. The
+// cache may be flushed on the way, so the given state is no longer valid
+// afterwards; only the returned one (or LAZY_REJECT) is.
+static int LazyDFA_fill(LazyDFA this, int state, int cls) {
+    this->misses += 1;
+    int n;
+    const int* states = SubsetMap_get(this->subsets, state, &n);
+    memcpy(this->current, states, n * sizeof(int));     // Interning below may move the pool
+    int m = NFA_subset_step(this->nfa, this->current, n, this->representative[cls], this->key);
+
+    int next = LAZY_REJECT;
+    long flushes = this->flushes;
+    if (m > 0) {
+        next = LazyDFA_state(this, this->key, m);
+    }
+    if (this->flushes == flushes) {
+        this->table[(size_t)state * this->numClasses + cls] = next;
+    }
+    return next;
+}
+
+// Finish a run on the NFA, from the given cached state over the rest of the input
+static bool LazyDFA_fall_back(LazyDFA this, int state, const uint8_t* input, size_t length) {
+    this->fallbacks += 1;
+    int n;
+    const int* states = SubsetMap_get(this->subsets, state, &n);
+    NFAStream stream = NFA_stream_begin_from(this->nfa, states, n);
+    NFA_stream_feed(stream, input, length);
+    return NFA_stream_end(stream);
+}
+
+bool LazyDFA_execute_buf(LazyDFA this, const uint8_t* input, size_t length) {
+    if (this->initial == -1) {
+        int n = NFA_initial_subset(this->nfa, this->key);
+        this->initial = LazyDFA_state(this, this->key, n);
+    }
+    int state = this->initial;
+    long misses = this->misses;
+    size_t mark = 0;        // Where progress was last brought up to date
+    size_t i = 0;
+    while (i < length && state != LAZY_REJECT) {
+        int cls = this->classes[input[i++]];
+        int next = this->table[(size_t)state * this->numClasses + cls];
+        if (next == LAZY_UNKNOWN) {
+            long flushes = this->flushes;
+            next = LazyDFA_fill(this, state, cls);
+            if (this->flushes != flushes) {
+                bool thrashing = this->progress + (i - mark) < (size_t)LAZY_MIN_PROGRESS * this->flushedStates;
+                this->progress = 0;
+                mark = i;
+                if (thrashing && next != LAZY_REJECT && i < length) {
+                    this->hits += (long)i - (this->misses - misses);
+                    return LazyDFA_fall_back(this, next, input + i, length - i);
+                }
+            }
+        }
+        state = next;
+    }
+    this->progress += i - mark;
+    this->hits += (long)i - (this->misses - misses);
+    return state != LAZY_REJECT && this->accepting[state];
+}
+
+bool LazyDFA_execute(LazyDFA this, char* input) {
+    return LazyDFA_execute_buf(this, (const uint8_t*)input, strlen(input));
+}
+
+void LazyDFA_get_stats(LazyDFA this, LazyDFAStats* stats) {
+    stats->hits = this->hits;
+    stats->misses = this->misses;
+    stats->flushes = this->flushes;
+    stats->fallbacks = this->fallbacks;
+    stats->states = SubsetMap_count(this->subsets);
+    stats->bytes = this->bytes;
+}
+
+void LazyDFA_print_stats(LazyDFA this, FILE* out) {
+    LazyDFAStats stats;
+    LazyDFA_get_stats(this, &stats);
+    long steps = stats.hits + stats.misses;
+    fprintf(out, "Lazy DFA: %ld hits, %ld misses (%.2f%% hit rate), %ld flushes, %ld runs finished on the NFA, "
+                 "%d states cached in %zu bytes\n",
+            stats.hits, stats.misses, steps > 0 ? 100.0 * stats.hits / steps : 0.0,
+            stats.flushes, stats.fallbacks, stats.states, stats.bytes);
+}
@@ -0,0 +1,77 @@
+//
+// File: lazy.h
+// Created: 10/17/2026
+//
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "nfa.h"
+
+/**
+ * A LazyDFA runs an NFA as a DFA whose states are only built when an input
+ * first leads to them, for NFAs whose full subset construction (NFA_to_DFA)
+ * would be too big. States and transitions are kept in a cache with a
+ * memory budget; when the cache is full it is flushed and refilled from
+ * the state the run is in. If it fills up again too quickly (the input
+ * keeps reaching new states), the rest of that run is done by the NFA
+ * itself, so a LazyDFA is never much slower than NFA_execute. A LazyDFA
+ * updates its cache as it runs, so it must not be used by more than one
+ * thread at a time.
+ */
+typedef struct LazyDFA* LazyDFA;
+
+/**
+ * Counters describing how well the cache is working. A hit is an input
+ * byte whose transition was already cached; a miss is one that had to be
+ * worked out from the NFA. Bytes run by the NFA after a fallback are
+ * neither.
+ */
+typedef struct LazyDFAStats {
+    long hits;
+    long misses;
+    long flushes;
+    long fallbacks;     // Runs finished on the NFA
+    int states;         // States in the cache now
+    size_t bytes;       // Estimated memory they take up
+} LazyDFAStats;
+
+/**
+ * Allocate and return a new LazyDFA for the given NFA, whose cache may use
+ * about the given number of bytes. The NFA must not be modified or freed
+ * while the LazyDFA is in use.
+ */
+extern LazyDFA new_LazyDFA(NFA nfa, size_t budget);
+
+/**
+ * Free the given LazyDFA (but not its NFA).
+ */
+extern void LazyDFA_free(LazyDFA this);
+
+/**
+ * Run the given LazyDFA on length bytes of input, and return true if the
+ * NFA accepts the input, otherwise false.
+ */
+extern bool LazyDFA_execute_buf(LazyDFA this, const uint8_t* input, size_t length);
+
+/**
+ * Run the given LazyDFA on the given input string, and return true if the
+ * NFA accepts the input, otherwise false.
+ */
+extern bool LazyDFA_execute(LazyDFA this, char* input);
+
+/**
+ * Fill in the given stats with the cache counters.
+ */
+extern void LazyDFA_get_stats(LazyDFA this, LazyDFAStats* stats);
+
+/**
+ * Print the cache counters to the given stream.
+ */
+extern void LazyDFA_print_stats(LazyDFA this, FILE* out);
+
+#endif //LAZY_H
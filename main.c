@@ -6,11 +6,288 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "dfa.h"
 #include "nfa.h"
 #include "translate.h"
+#include "minimize.h"
+#include "scan.h"
+#include "batch.h"
+#include "parallel.h"
+#include "regex.h"
+#include "lazy.h"
+
+// Replace the given DFA with its minimal equivalent
+static void minimize(DFA* dfa) {
+    DFA minimal = DFA_minimize(*dfa, NULL);
+    printf("Minimized from %d to %d states\n", DFA_get_size(*dfa), DFA_get_size(minimal));
+    DFA_free(*dfa);
+    *dfa = minimal;
+}
+
+// Convert the given NFA to a DFA, minimize it and free the NFA
+static DFA* determinize(NFA* nfa) {
+    DFA* dfa = NFA_to_DFA(nfa);
+    DFA minimal = DFA_minimize(*dfa, NULL);
+    DFA_free(*dfa);
+    *dfa = minimal;
+    NFA_free(*nfa);
+    free(nfa);
+    return dfa;
+}
+
+// Return a new NFA for the automaton with the given name, or NULL if there is
+// no such NFA. A name written between slashes (/ab+c/) is compiled as a
+// regular expression.
+static NFA* nfa_named(const char* name) {
+    size_t length = strlen(name);
+    if (length >= 2 && name[0] == '/' && name[length - 1] == '/') {
+        char* pattern = (char*)malloc(length - 1);
+        memcpy(pattern, name + 1, length - 2);
+        pattern[length - 2] = '\0';
+        NFA* nfa = NFA_for_regex(pattern);
+        free(pattern);
+        return nfa;
+    }
+    struct {
+        const char* name;
+        NFA* (*nfa)(void);
+    } automata[] = {
+        { "ked", NFA_for_ends_with_ked },
+        { "ath", NFA_for_contains_ath },
+        { "conference", NFA_for_conference },
+    };
+    for (size_t i = 0; i < sizeof(automata) / sizeof(automata[0]); i++) {
+        if (strcmp(name, automata[i].name) == 0) {
+            return automata[i].nfa();
+        }
+    }
+    return NULL;
+}
+
+// Return a new DFA for the automaton with the given name, or NULL if there is
+// no such automaton. NFAs (see nfa_named) are converted and minimized, and a
+// name ending in .dfa is loaded from a file saved by the compile command.
+static DFA* automaton_named(const char* name) {
+    size_t length = strlen(name);
+    if (length > 4 && strcmp(name + length - 4, ".dfa") == 0) {
+        DFA loaded = DFA_load(name);
+        if (loaded == NULL) {
+            return NULL;
+        }
+        DFA* dfa = malloc(sizeof(DFA));
+        *dfa = loaded;
+        return dfa;
+    }
+    struct {
+        const char* name;
+        DFA* (*dfa)(void);
+    } automata[] = {
+        { "dfa", DFA_for_contains_dfa },
+        { "cat", DFA_for_contains_cat },
+        { "two2", DFA_for_contains_two2 },
+        { "evenOdd", DFA_for_contains_evenOdd },
+    };
+    for (size_t i = 0; i < sizeof(automata) / sizeof(automata[0]); i++) {
+        if (strcmp(name, automata[i].name) == 0) {
+            return automata[i].dfa();
+        }
+    }
+    NFA* nfa = nfa_named(name);
+    return nfa == NULL ? NULL : determinize(nfa);
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: program                           interactive tour of the automata\n"
+                    "       program scan [-l] AUTOMATON FILE  report match end offsets (or, with -l,\n"
+                    "                                         accept/reject for each line) in FILE\n"
+                    "       program match [-j THREADS] AUTOMATON FILE\n"
+                    "                                         accept/reject for the whole of FILE,\n"
+                    "                                         split across THREADS threads\n"
+                    "       program find AUTOMATON FILE       report the start and end offsets of the\n"
+                    "                                         leftmost-longest matches in FILE\n"
+                    "       program batch [-b|-c] [-j THREADS | -L BYTES] AUTOMATON [FILE]\n"
+                    "                                         print the lines of FILE (or stdin) that\n"
+                    "                                         are accepted, or with -b a 1/0 per line,\n"
+                    "                                         or with -c the accepted and total counts,\n"
+                    "                                         using THREADS worker threads, or with -L\n"
+                    "                                         running the NFA AUTOMATON as a lazy DFA\n"
+                    "                                         with a cache of BYTES\n"
+                    "       program compile AUTOMATON OUT.dfa save AUTOMATON to OUT.dfa, which can then\n"
+                    "                                         be given as the AUTOMATON of the others\n"
+                    "automata: dfa cat two2 evenOdd ked ath conference, /REGEX/, or FILE.dfa\n");
+    return 2;
+}
+
+// program scan [-l] AUTOMATON FILE
+static int scan_command(int argc, char* argv[]) {
+    bool perLine = false;
+    int arg = 0;
+    if (arg < argc && strcmp(argv[arg], "-l") == 0) {
+        perLine = true;
+        arg++;
+    }
+    if (argc - arg != 2) {
+        return usage();
+    }
+    DFA* dfa = automaton_named(argv[arg]);
+    if (dfa == NULL) {
+        fprintf(stderr, "unknown automaton: %s\n", argv[arg]);
+        return usage();
+    }
+    int status = DFA_scan_file(*dfa, argv[arg + 1], perLine, stdout) == 0 ? 0 : 1;
+    DFA_free(*dfa);
+    free(dfa);
+    return status;
+}
+
+// program match [-j THREADS] AUTOMATON FILE
+static int match_command(int argc, char* argv[]) {
+    int nthreads = 1;
+    int arg = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0 && atoi(argv[arg + 1]) > 0) {
+        nthreads = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (argc - arg != 2) {
+        return usage();
+    }
+    DFA* dfa = automaton_named(argv[arg]);
+    if (dfa == NULL) {
+        fprintf(stderr, "unknown automaton: %s\n", argv[arg]);
+        return usage();
+    }
+    int status = DFA_match_file(*dfa, argv[arg + 1], nthreads, stdout) == 0 ? 0 : 1;
+    DFA_free(*dfa);
+    free(dfa);
+    return status;
+}
+
+// program find AUTOMATON FILE
+static int find_command(int argc, char* argv[]) {
+    if (argc != 2) {
+        return usage();
+    }
+    DFA* dfa = automaton_named(argv[0]);
+    if (dfa == NULL) {
+        fprintf(stderr, "unknown automaton: %s\n", argv[0]);
+        return usage();
+    }
+    int status = DFA_find_file(*dfa, argv[1], stdout) == 0 ? 0 : 1;
+    DFA_free(*dfa);
+    free(dfa);
+    return status;
+}
+
+// program compile AUTOMATON OUT.dfa
+static int compile_command(int argc, char* argv[]) {
+    if (argc != 2) {
+        return usage();
+    }
+    DFA* dfa = automaton_named(argv[0]);
+    if (dfa == NULL) {
+        fprintf(stderr, "unknown automaton: %s\n", argv[0]);
+        return usage();
+    }
+    int status = DFA_save(*dfa, argv[1]) == 0 ? 0 : 1;
+    DFA_free(*dfa);
+    free(dfa);
+    return status;
+}
+
+// program batch -L BYTES: run the lines through a LazyDFA for the NFA with the
+// given name, and report how its cache did on stderr
+static int batch_lazy(FILE* in, BatchMode mode, const char* name, size_t budget) {
+    NFA* nfa = nfa_named(name);
+    if (nfa == NULL) {
+        fprintf(stderr, "unknown NFA: %s\n", name);
+        return usage();
+    }
+    LazyDFA lazy = new_LazyDFA(*nfa, budget);
+    int status = Batch_run(in, stdout, mode, Batch_match_LazyDFA, NULL, lazy) == 0 ? 0 : 1;
+    LazyDFA_print_stats(lazy, stderr);
+    LazyDFA_free(lazy);
+    NFA_free(*nfa);
+    free(nfa);
+    return status;
+}
+
+// program batch [-b|-c] [-j THREADS | -L BYTES] AUTOMATON [FILE]
+static int batch_command(int argc, char* argv[]) {
+    BatchMode mode = BATCH_MATCHES;
+    int nthreads = 1;
+    long budget = 0;
+    int arg = 0;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-b") == 0) {
+            mode = BATCH_BITMAP;
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            mode = BATCH_COUNTS;
+        } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) > 0) {
+            nthreads = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-L") == 0 && arg + 1 < argc && atol(argv[arg + 1]) > 0) {
+            budget = atol(argv[++arg]);
+        } else {
+            return usage();
+        }
+    }
+    if ((argc - arg != 1 && argc - arg != 2) || (budget > 0 && nthreads > 1)) {
+        return usage();
+    }
+    FILE* in = stdin;
+    if (argc - arg == 2) {
+        in = fopen(argv[arg + 1], "rb");
+        if (in == NULL) {
+            perror(argv[arg + 1]);
+            return 1;
+        }
+    }
+    if (budget > 0) {
+        int status = batch_lazy(in, mode, argv[arg], (size_t)budget);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return status;
+    }
+    DFA* dfa = automaton_named(argv[arg]);
+    if (dfa == NULL) {
+        fprintf(stderr, "unknown automaton: %s\n", argv[arg]);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return usage();
+    }
+    DFA_prepare(*dfa);
+    int status = Batch_run_parallel(in, stdout, mode, Batch_match_DFA, Batch_match_many_DFA,
+                                    dfa, nthreads) == 0 ? 0 : 1;
+    if (in != stdin) {
+        fclose(in);
+    }
+    DFA_free(*dfa);
+    free(dfa);
+    return status;
+}
+
+int main (int argc, char* argv[]) {
+    if (argc > 1) {
+        if (strcmp(argv[1], "scan") == 0) {
+            return scan_command(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "match") == 0) {
+            return match_command(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "find") == 0) {
+            return find_command(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "batch") == 0) {
+            return batch_command(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "compile") == 0) {
+            return compile_command(argc - 2, argv + 2);
+        }
+        return usage();
+    }
 
-int main () {
     printf("CSC173 Project by Hailey Wong-Budiman\n\n");
 
     // Part 1: DFA
@@ -59,6 +336,7 @@ int main () {
 
     printf("Testing NFA to DFA conversion for NFA Pt 1\nTesting DFA that recognizes strings ending with \"ked\"\n");
     DFA* dfa5 = NFA_to_DFA(nfa1);
+    minimize(dfa5);
     DFA_repl(dfa5);
     NFA_free(*nfa1);
     free(nfa1);
@@ -67,6 +345,7 @@ int main () {
 
     printf("Testing NFA to DFA conversion for NFA Pt 2\nTesting DFA that recognizes strings containing \"ath\"\n");
     DFA* dfa6 = NFA_to_DFA(nfa2);
+    minimize(dfa6);
     DFA_repl(dfa6);
     NFA_free(*nfa2);
     free(nfa2);
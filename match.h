@@ -0,0 +1,26 @@
+/**
+ * Definitions shared by the DFA and NFA match-finding functions
+ * (DFA_find, NFA_find and friends).
+ *
+ * A match is a part of the input that the automaton accepts when run on
+ * it alone: input[start] up to but not including input[end].
+ */
+
+#ifndef _match_h
+#define _match_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Match {
+	size_t start;
+	size_t end;
+} Match;
+
+/**
+ * Called by DFA_find_all and NFA_find_all for each match, in order.
+ * Return false to stop looking for more.
+ */
+typedef bool (*MatchCallback)(Match match, void* ctx);
+
+#endif
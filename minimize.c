@@ -0,0 +1,314 @@
+//
+// File: minimize.c
+// Created: 10/17/2026
+//
+// Hopcroft's DFA minimization. The reject state is made explicit as an extra
+// state (numbered after the reachable states) that loops to itself, so every
+// state has a transition on every input class. States are then split into
+// blocks of equivalent states: start from {accepting, non-accepting} (with
+// the accepting states further split by their pattern ids, if any), and
+// repeatedly use a (block, class) pair from the worklist to split every block
+// whose states disagree on whether that class leads into the block. Only the
+// smaller half of a split needs to go back on the worklist, which is what
+// gives the O(n log n) bound per class.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minimize.h"
+
+// A partition of the states 0..n-1 into blocks. The states of each block
+// are contiguous in elems; during a split, the marked states of block b are
+// moved to the front of its range, up to mid[b].
+struct Partition {
+    int* elems;     // States, grouped by block
+    int* loc;       // Position of each state in elems
+    int* block;     // Block of each state
+    int* first;     // Range of each block in elems is [first, end)
+    int* end;
+    int* mid;       // End of the marked states of each block
+    int count;      // Number of blocks
+    int* touched;   // Blocks with marked states
+    int ntouched;
+};
+
+static void Partition_init(struct Partition* p, int n) {
+    p->elems = (int*)malloc(n * sizeof(int));
+    p->loc = (int*)malloc(n * sizeof(int));
+    p->block = (int*)malloc(n * sizeof(int));
+    p->first = (int*)malloc(n * sizeof(int));
+    p->end = (int*)malloc(n * sizeof(int));
+    p->mid = (int*)malloc(n * sizeof(int));
+    p->touched = (int*)malloc(n * sizeof(int));
+    p->ntouched = 0;
+    for (int i = 0; i < n; i++) {
+        p->elems[i] = i;
+        p->loc[i] = i;
+        p->block[i] = 0;
+    }
+    p->first[0] = 0;
+    p->end[0] = n;
+    p->mid[0] = 0;
+    p->count = n > 0 ? 1 : 0;
+}
+
+static void Partition_free(struct Partition* p) {
+    free(p->elems);
+    free(p->loc);
+    free(p->block);
+    free(p->first);
+    free(p->end);
+    free(p->mid);
+    free(p->touched);
+}
+
+// Mark the given state by swapping it into the marked part of its block
+static void Partition_mark(struct Partition* p, int state) {
+    int b = p->block[state];
+    int i = p->loc[state];
+    int j = p->mid[b];
+    if (i < j) {
+        return; // Already marked
+    }
+    if (j == p->first[b]) {
+        p->touched[p->ntouched++] = b;
+    }
+    int other = p->elems[j];
+    p->elems[j] = state;
+    p->loc[state] = j;
+    p->elems[i] = other;
+    p->loc[other] = i;
+    p->mid[b] = j + 1;
+}
+
+// Split the given block into its marked and unmarked states, returning the
+// new block (the marked ones) or -1 if every state was marked.
+static int Partition_split(struct Partition* p, int b) {
+    if (p->mid[b] == p->end[b]) {
+        p->mid[b] = p->first[b];
+        return -1;
+    }
+    int nb = p->count++;
+    p->first[nb] = p->first[b];
+    p->end[nb] = p->mid[b];
+    p->mid[nb] = p->first[nb];
+    p->first[b] = p->mid[b];
+    for (int i = p->first[nb]; i < p->end[nb]; i++) {
+        p->block[p->elems[i]] = nb;
+    }
+    return nb;
+}
+
+static int block_size(const struct Partition* p, int b) {
+    return p->end[b] - p->first[b];
+}
+
+DFA DFA_minimize(DFA dfa, int* remap) {
+    int n = DFA_get_size(dfa);
+    int k = DFA_get_num_classes(dfa);
+    int initial = DFA_get_initialState(dfa);
+
+    // Number the states reachable from the initial state (breadth first),
+    // with the explicit reject state after them
+    int* index = (int*)malloc(n * sizeof(int));    // Reachable index of each original state, or -1
+    int* states = (int*)malloc(n * sizeof(int));   // Original state of each reachable index
+    memset(index, -1, n * sizeof(int));
+    int m = 0;
+    if (n > 0) {
+        index[initial] = m;
+        states[m++] = initial;
+    }
+    for (int i = 0; i < m; i++) {
+        for (int c = 0; c < k; c++) {
+            int t = DFA_get_class_transition(dfa, states[i], c);
+            if (t != -1 && index[t] == -1) {
+                index[t] = m;
+                states[m++] = t;
+            }
+        }
+    }
+    int dead = m;
+    int total = m + 1;
+
+    // Predecessor lists for each (class, state), as one array indexed by offsets
+    int* delta = (int*)malloc((size_t)total * k * sizeof(int));
+    for (int i = 0; i < total; i++) {
+        for (int c = 0; c < k; c++) {
+            int t = i == dead ? -1 : DFA_get_class_transition(dfa, states[i], c);
+            delta[(size_t)i * k + c] = t == -1 ? dead : index[t];
+        }
+    }
+    int* offsets = (int*)calloc((size_t)total * k + 1, sizeof(int));
+    for (size_t e = 0; e < (size_t)total * k; e++) {
+        int c = (int)(e % k);
+        offsets[(size_t)c * total + delta[e] + 1] += 1;
+    }
+    for (size_t i = 0; i < (size_t)total * k; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    int* preds = (int*)malloc((size_t)total * k * sizeof(int));
+    int* fill = (int*)malloc((size_t)total * k * sizeof(int));
+    memcpy(fill, offsets, (size_t)total * k * sizeof(int));
+    for (int i = 0; i < total; i++) {
+        for (int c = 0; c < k; c++) {
+            preds[fill[(size_t)c * total + delta[(size_t)i * k + c]]++] = i;
+        }
+    }
+    free(fill);
+
+    // Initial partition: non-accepting states (including the reject state),
+    // and accepting states grouped by their set of pattern ids. Each group of
+    // accepting states is split off in turn, bucketed by set so this stays linear.
+    struct Partition p;
+    Partition_init(&p, total);
+    int nsets = 0;
+    for (int i = 0; i < m; i++) {
+        int set = DFA_get_pattern_set(dfa, states[i]);
+        if (set >= nsets) {
+            nsets = set + 1;
+        }
+    }
+    int* bucket = (int*)calloc(nsets + 1, sizeof(int));    // Accepting states by set, counting sort
+    int* accepting = (int*)malloc((m > 0 ? m : 1) * sizeof(int));
+    for (int i = 0; i < m; i++) {
+        if (DFA_get_accepting(dfa, states[i])) {
+            bucket[DFA_get_pattern_set(dfa, states[i]) + 1] += 1;
+        }
+    }
+    for (int set = 0; set < nsets; set++) {
+        bucket[set + 1] += bucket[set];
+    }
+    int* fillBucket = (int*)malloc(nsets * sizeof(int));
+    memcpy(fillBucket, bucket, nsets * sizeof(int));
+    for (int i = 0; i < m; i++) {
+        if (DFA_get_accepting(dfa, states[i])) {
+            accepting[fillBucket[DFA_get_pattern_set(dfa, states[i])]++] = i;
+        }
+    }
+    free(fillBucket);
+    for (int set = 0; set < nsets; set++) {
+        for (int j = bucket[set]; j < bucket[set + 1]; j++) {
+            Partition_mark(&p, accepting[j]);
+        }
+        if (p.ntouched > 0) {
+            p.ntouched = 0;
+            Partition_split(&p, 0);
+        }
+    }
+    free(bucket);
+    free(accepting);
+
+    // Worklist of (block, class) splitters: every initial block but the largest
+    char* inWorklist = (char*)calloc((size_t)total * k, 1);
+    int* worklist = (int*)malloc((size_t)total * k * sizeof(int));
+    int nwork = 0;
+    int largest = 0;
+    for (int b = 1; b < p.count; b++) {
+        if (block_size(&p, b) > block_size(&p, largest)) {
+            largest = b;
+        }
+    }
+    for (int b = 0; b < p.count; b++) {
+        if (b == largest) {
+            continue;
+        }
+        for (int c = 0; c < k; c++) {
+            worklist[nwork++] = b * k + c;
+            inWorklist[(size_t)b * k + c] = 1;
+        }
+    }
+
+    int* splitter = (int*)malloc(total * sizeof(int));
+    while (nwork > 0) {
+        int item = worklist[--nwork];
+        int b = item / k;
+        int c = item % k;
+        inWorklist[item] = 0;
+
+        // Copy the splitter's states first, since marking reorders blocks
+        int size = block_size(&p, b);
+        memcpy(splitter, p.elems + p.first[b], size * sizeof(int));
+        for (int i = 0; i < size; i++) {
+            size_t list = (size_t)c * total + splitter[i];
+            for (int j = offsets[list]; j < offsets[list + 1]; j++) {
+                Partition_mark(&p, preds[j]);
+            }
+        }
+
+        for (int t = 0; t < p.ntouched; t++) {
+            int x = p.touched[t];
+            int nb = Partition_split(&p, x);
+            if (nb == -1) {
+                continue;
+            }
+            int smaller = block_size(&p, nb) <= block_size(&p, x) ? nb : x;
+            for (int d = 0; d < k; d++) {
+                int target = inWorklist[(size_t)x * k + d] ? nb : smaller;
+                worklist[nwork++] = target * k + d;
+                inWorklist[(size_t)target * k + d] = 1;
+            }
+        }
+        p.ntouched = 0;
+    }
+    free(splitter);
+
+    // Number the blocks in breadth-first order from the initial block,
+    // leaving out the block of the reject state
+    int deadBlock = p.block[dead];
+    int* number = (int*)malloc(p.count * sizeof(int));
+    int* order = (int*)malloc(p.count * sizeof(int));
+    memset(number, -1, p.count * sizeof(int));
+    int blocks = 0;
+    if (m > 0 && p.block[0] != deadBlock) {
+        number[p.block[0]] = blocks;
+        order[blocks++] = p.block[0];
+    }
+    for (int i = 0; i < blocks; i++) {
+        int rep = p.elems[p.first[order[i]]];
+        for (int c = 0; c < k; c++) {
+            int b = p.block[delta[(size_t)rep * k + c]];
+            if (b != deadBlock && number[b] == -1) {
+                number[b] = blocks;
+                order[blocks++] = b;
+            }
+        }
+    }
+
+    // Build the minimal DFA over the same input classes
+    unsigned char classes[DFA_ALPHABET_SIZE];
+    for (int sym = 0; sym < DFA_ALPHABET_SIZE; sym++) {
+        classes[sym] = (unsigned char)DFA_get_class(dfa, (char)sym);
+    }
+    DFA result = new_DFA_classes(blocks > 0 ? blocks : 1, classes, k);
+    for (int i = 0; i < blocks; i++) {
+        int rep = p.elems[p.first[order[i]]];
+        DFA_set_accepting(result, i, DFA_get_accepting(dfa, states[rep]));
+        int npatterns;
+        const int* patterns = DFA_get_patterns(dfa, states[rep], &npatterns);
+        DFA_set_patterns(result, i, patterns, npatterns);
+        for (int c = 0; c < k; c++) {
+            DFA_set_class_transition(result, i, c, number[p.block[delta[(size_t)rep * k + c]]]);
+        }
+    }
+    DFA_set_initialState(result, 0);
+    DFA_compress(result);
+
+    if (remap != NULL) {
+        for (int s = 0; s < n; s++) {
+            remap[s] = index[s] == -1 ? -1 : number[p.block[index[s]]];
+        }
+    }
+
+    Partition_free(&p);
+    free(number);
+    free(order);
+    free(inWorklist);
+    free(worklist);
+    free(offsets);
+    free(preds);
+    free(delta);
+    free(index);
+    free(states);
+    return result;
+}
@@ -0,0 +1,24 @@
+//
+// File: minimize.h
+// Created: 10/17/2026
+//
+
+#ifndef MINIMIZE_H
+#define MINIMIZE_H
+
+#include "dfa.h"
+
+/**
+ * Return a new DFA with the fewest possible states that accepts the same
+ * language as the given DFA, computed with Hopcroft's partition refinement
+ * algorithm. Unreachable states are dropped, and states that can never
+ * reach an accepting state are folded into the reject state (-1).
+ * If remap is not NULL it must have room for DFA_get_size(dfa) ints, and
+ * remap[s] is set to the state of the new DFA that state s became, or -1
+ * if it was dropped. States are only merged if they have the same pattern
+ * ids (see DFA_set_patterns), which the new DFA keeps. The given DFA is not
+ * modified.
+ */
+extern DFA DFA_minimize(DFA dfa, int* remap);
+
+#endif //MINIMIZE_H
@@ -7,32 +7,85 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include "dfa.h"
 #include "nfa.h"
-#include "IntHashSet.h"
+#include "simd.h"
+#include "BitSet.h"
+
+// Kinds of edge out of a state
+#define EDGE_SYM 0      // On sym only
+#define EDGE_ANY 1      // On every symbol
+#define EDGE_ALL_BUT 2  // On every symbol except sym
+#define EDGE_EPSILON 3  // On no symbol: dst is active whenever src is
+
+// One edge of the transition function. NFA_add_transition_all and
+// NFA_add_transition_all_but store a single edge rather than one per symbol.
+struct Edge {
+    unsigned char kind;
+    unsigned char sym;
+    int dst;
+};
+
+// The edges leaving one state, in a growable array
+struct Edges {
+    struct Edge* edges;
+    int count;
+    int capacity;
+};
 
 struct NFA{
     int numStates;
     int initialState;
-    IntHashSet acceptingStates;
-    IntHashSet** transitions;
-    bool testing;
+    Set acceptingStates;
+    struct Edges* transitions;  // Edges leaving each state
+    int epsilons;               // Number of epsilon edges
+    Set scratch;                // Returned by NFA_get_transitions
+    // Epsilon closure of each state (words words each), built on first use
+    // and thrown away whenever the NFA is modified. NULL if there are no
+    // epsilon edges, when every state's closure is just itself.
+    uint64_t* closures;
+    // Bit-parallel form of the transition function, built on first use by
+    // NFA_execute and thrown away whenever the NFA is modified.
+    int words;              // 64-bit words per set of states
+    unsigned char classes[NFA_ALPHABET_SIZE];  // Input symbol classes (see NFA_get_classes)
+    uint64_t* successors;   // Set of next states for (class, state) at ((class * numStates) + state) * words
+    uint64_t* acceptMask;   // Set of accepting states
+    uint64_t* initialMask;  // Set of states active at the start (the initial state's closure)
+    // If the initial state goes only to itself on all but a few input bytes,
+    // those bytes: while it is the only active state, NFA_advance skips
+    // straight to the next of them (see NFA_build_skip).
+    int skipCount;          // -1 if not
+    uint8_t skipBytes[SIMD_FIND_MAX];
 };
 
+static void NFA_discard_masks(NFA nfa) {
+    free(nfa->successors);
+    free(nfa->acceptMask);
+    free(nfa->initialMask);
+    free(nfa->closures);
+    nfa->successors = NULL;
+    nfa->acceptMask = NULL;
+    nfa->initialMask = NULL;
+    nfa->closures = NULL;
+    nfa->skipCount = -1;
+}
+
 // Allocate and return a new NFA containing the given number of states.
 NFA new_NFA(int nstates) {
     NFA nfa = (NFA)malloc(sizeof(struct NFA));
     nfa->numStates = nstates;
     nfa->initialState = 0;
-    nfa->testing=false;
-    nfa->transitions = (IntHashSet**)malloc(nstates * sizeof(IntHashSet*));
-    for (int i = 0; i < nstates; i++) {
-        nfa->transitions[i] = (IntHashSet *)malloc(128 * sizeof(IntHashSet));
-        for (int j = 0; j < 128; j++) {
-            nfa->transitions[i][j] = new_IntHashSet(20);
-        }
-    }
-    nfa->acceptingStates = new_IntHashSet(nstates);
+    nfa->transitions = (struct Edges*)calloc(nstates, sizeof(struct Edges));
+    nfa->epsilons = 0;
+    nfa->closures = NULL;
+    nfa->acceptingStates = new_Set(nstates);
+    nfa->scratch = NULL;
+    nfa->words = (nstates + 63) / 64;
+    nfa->successors = NULL;
+    nfa->acceptMask = NULL;
+    nfa->initialMask = NULL;
+    nfa->skipCount = -1;
     return nfa;
 }
 
@@ -40,28 +93,19 @@ int getStates (NFA this){
     return this->numStates;
 }
 
-bool getTest (NFA this){
-    return this->testing;
-}
-
-bool setTest (NFA this){
-    return this->testing = true;
-}
-
-IntHashSet getAcceptingStates (NFA nfa){
+Set getAcceptingStates (NFA nfa){
     return nfa->acceptingStates;
 }
 
 // Free the given NFA
 void NFA_free(NFA nfa) {
-    IntHashSet_free(nfa->acceptingStates);
+    Set_free(nfa->acceptingStates);
     for (int i = 0; i < nfa->numStates; i++){
-        for (int j = 0; j < 128; j++) { // Corrected loop limit
-            IntHashSet_free(nfa->transitions[i][j]);
-        }
-        free(nfa->transitions[i]);
+        free(nfa->transitions[i].edges);
     }
     free(nfa->transitions);
+    Set_free(nfa->scratch);
+    NFA_discard_masks(nfa);
     free(nfa);
 }
 
@@ -70,19 +114,120 @@ int NFA_get_size(NFA nfa) {
     return nfa->numStates;
 }
 
+// Return the initial state of the given NFA.
+int NFA_get_initialState(NFA nfa) {
+    return nfa->initialState;
+}
+
+// Return true if the given edge is taken on input symbol sym
+static inline bool edge_matches(const struct Edge* edge, unsigned char sym) {
+    switch (edge->kind) {
+        case EDGE_SYM:
+            return edge->sym == sym;
+        case EDGE_ALL_BUT:
+            return edge->sym != sym;
+        case EDGE_EPSILON:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Work out the epsilon closure of every state, as a bit vector per state, by
+// a depth-first search along epsilon edges from each one.
+static void NFA_build_closures(NFA nfa) {
+    int n = nfa->numStates;
+    int words = nfa->words;
+    nfa->closures = (uint64_t*)calloc((size_t)n * words, sizeof(uint64_t));
+    int* stack = (int*)malloc(n * sizeof(int));
+    for (int state = 0; state < n; state++) {
+        uint64_t* closure = nfa->closures + (size_t)state * words;
+        closure[state / 64] |= (uint64_t)1 << (state % 64);
+        int top = 0;
+        stack[top++] = state;
+        while (top > 0) {
+            const struct Edges* out = &nfa->transitions[stack[--top]];
+            for (int i = 0; i < out->count; i++) {
+                int dst = out->edges[i].dst;
+                uint64_t bit = (uint64_t)1 << (dst % 64);
+                if (out->edges[i].kind == EDGE_EPSILON && (closure[dst / 64] & bit) == 0) {
+                    closure[dst / 64] |= bit;
+                    stack[top++] = dst;
+                }
+            }
+        }
+    }
+    free(stack);
+}
+
+// Add the given state and every state reachable from it by epsilon edges to the given set.
+void NFA_union_closure(NFA nfa, int state, Set states) {
+    if (nfa->epsilons == 0) {
+        Set_insert(states, state);
+        return;
+    }
+    if (nfa->closures == NULL) {
+        NFA_build_closures(nfa);
+    }
+    const uint64_t* closure = nfa->closures + (size_t)state * nfa->words;
+    for (int w = 0; w < nfa->words; w++) {
+        for (uint64_t bits = closure[w]; bits != 0; bits &= bits - 1) {
+            Set_insert(states, w * 64 + BitSet_lowest(bits));
+        }
+    }
+}
+
+// Add to the given set the next states from the given state on input symbol sym,
+// along with their epsilon closures.
+void NFA_union_transitions(NFA nfa, int state, char sym, Set states) {
+    const struct Edges* out = &nfa->transitions[state];
+    for (int i = 0; i < out->count; i++) {
+        if (edge_matches(&out->edges[i], (unsigned char)sym)) {
+            NFA_union_closure(nfa, out->edges[i].dst, states);
+        }
+    }
+}
+
 // Return the set of next states specified by the given NFA's transition function from the given state on input symbol sym.
-IntHashSet NFA_get_transitions(NFA nfa, int state, char sym) {
-    return nfa->transitions[state][(int)sym];
+// The set is rebuilt from the state's edges and belongs to the NFA, so it is only valid until the next call.
+Set NFA_get_transitions(NFA nfa, int state, char sym) {
+    Set_free(nfa->scratch);
+    nfa->scratch = new_Set(nfa->numStates);
+    NFA_union_transitions(nfa, state, sym, nfa->scratch);
+    return nfa->scratch;
+}
+
+// Append an edge to the given state unless it is already there.
+static void NFA_add_edge(NFA nfa, int src, unsigned char kind, unsigned char sym, int dst) {
+    struct Edges* out = &nfa->transitions[src];
+    for (int i = 0; i < out->count; i++) {
+        const struct Edge* edge = &out->edges[i];
+        if (edge->kind == kind && edge->sym == sym && edge->dst == dst) {
+            return;
+        }
+    }
+    if (out->count == out->capacity) {
+        out->capacity = out->capacity == 0 ? 2 : out->capacity * 2;
+        out->edges = (struct Edge*)realloc(out->edges, out->capacity * sizeof(struct Edge));
+    }
+    out->edges[out->count].kind = kind;
+    out->edges[out->count].sym = sym;
+    out->edges[out->count].dst = dst;
+    out->count += 1;
+    if (kind == EDGE_EPSILON) {
+        nfa->epsilons += 1;
+    }
+    NFA_discard_masks(nfa);
 }
 
 // For the given NFA, add the state dst to the set of next states from state src on input symbol sym.
 void NFA_add_transition(NFA nfa, int src, char sym, int dst) {
-    IntHashSet_insert(nfa->transitions[src][(int)sym], dst);
+    NFA_add_edge(nfa, src, EDGE_SYM, (unsigned char)sym, dst);
 }
 
 // Add a transition for the given NFA for each symbol in the given str.
 void NFA_add_transition_str(NFA nfa, int src, char *str, int dst) {
-    for (int i = 0; i < strlen(str); i++) {
+    for (size_t i = 0; i < strlen(str); i++) {
         char input = str[i];
         NFA_add_transition(nfa, src, input, dst);
     }
@@ -90,74 +235,664 @@ void NFA_add_transition_str(NFA nfa, int src, char *str, int dst) {
 
 // Add a transition for the given NFA for each input symbol.
 void NFA_add_transition_all(NFA nfa, int src, int dst) {
-    for (int i = 0; i < 128; i++) {
-        IntHashSet_insert(nfa->transitions[src][i], dst);
-    }
+    NFA_add_edge(nfa, src, EDGE_ANY, 0, dst);
 }
 
 // Add a transition for the given NFA for each input symbol except for a certain one.
 void NFA_add_transition_all_but(NFA nfa, int src, char sym, int dst){
-    for (int i = 0; i < 128; i++){
-        if (i != (int)sym) {
-            IntHashSet_insert(nfa->transitions[src][i], dst);
+    NFA_add_edge(nfa, src, EDGE_ALL_BUT, (unsigned char)sym, dst);
+}
+
+// Add an epsilon transition to the given NFA, so that state dst is active whenever state src is.
+void NFA_add_epsilon(NFA nfa, int src, int dst) {
+    NFA_add_edge(nfa, src, EDGE_EPSILON, 0, dst);
+}
+
+// Return a new NFA that accepts the strings accepted by any of the given NFAs.
+// State s of nfas[k] becomes state offsets[k] + s, and the new initial state 0
+// gets a copy of the edges out of each of their initial states (nothing leads
+// back into it, so it is only ever active at the start).
+NFA NFA_union(NFA* nfas, int count, int* offsets) {
+    int size = 1;
+    for (int k = 0; k < count; k++) {
+        offsets[k] = size;
+        size += nfas[k]->numStates;
+    }
+    NFA nfa = new_NFA(size);
+    for (int k = 0; k < count; k++) {
+        NFA part = nfas[k];
+        for (int state = 0; state < part->numStates; state++) {
+            const struct Edges* out = &part->transitions[state];
+            for (int i = 0; i < out->count; i++) {
+                const struct Edge* edge = &out->edges[i];
+                NFA_add_edge(nfa, offsets[k] + state, edge->kind, edge->sym, offsets[k] + edge->dst);
+                if (state == part->initialState) {
+                    NFA_add_edge(nfa, 0, edge->kind, edge->sym, offsets[k] + edge->dst);
+                }
+            }
+            if (NFA_get_accepting(part, state)) {
+                NFA_set_accepting(nfa, offsets[k] + state, true);
+                if (state == part->initialState) {
+                    NFA_set_accepting(nfa, 0, true);
+                }
+            }
         }
     }
+    return nfa;
 }
 
 // Set whether the given NFA's state is accepting or not.
 void NFA_set_accepting(NFA nfa, int state, bool value) {
     if (value) {
-        IntHashSet_insert(nfa->acceptingStates, state);
+        Set_insert(nfa->acceptingStates, state);
+        NFA_discard_masks(nfa);
     }
 }
 
 // Return true if the given NFA's state is an accepting state.
 bool NFA_get_accepting(NFA nfa, int state) {
-    return IntHashSet_lookup(nfa->acceptingStates, state);
+    return Set_lookup(nfa->acceptingStates, state);
+}
+
+// Split every class of the partition in classes (numbered 0 to n-1) into the
+// symbols that are in the given set and those that aren't, then renumber the
+// classes in order of their smallest symbol. Return the new number of classes.
+// The new ids are worked out as ints, since until they are renumbered they
+// can go past 255 (a class that is wholly in the set still gets a new id).
+static int refine_classes(unsigned char* classes, int n, const bool* in) {
+    int ids[NFA_ALPHABET_SIZE];
+    int split[2 * NFA_ALPHABET_SIZE];
+    for (int cls = 0; cls < n; cls++) {
+        split[cls] = -1;
+    }
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+        ids[sym] = classes[sym];
+        if (in[sym]) {
+            int cls = classes[sym];
+            if (split[cls] == -1) {
+                split[cls] = n++;
+            }
+            ids[sym] = split[cls];
+        }
+    }
+    int renumber[2 * NFA_ALPHABET_SIZE];
+    for (int cls = 0; cls < n; cls++) {
+        renumber[cls] = -1;
+    }
+    int count = 0;
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+        if (renumber[ids[sym]] == -1) {
+            renumber[ids[sym]] = count++;
+        }
+        classes[sym] = (unsigned char)renumber[ids[sym]];
+    }
+    return count;
+}
+
+// Group the input symbols into classes that every state of the NFA treats the
+// same way, storing the class of each of the 256 symbols in classes, and return
+// the number of classes. Symbols only ever reached through "any" edges all end
+// up in one class, so this is usually just a handful.
+int NFA_get_classes(NFA nfa, unsigned char* classes) {
+    memset(classes, 0, NFA_ALPHABET_SIZE);
+    int n = 1;
+    bool in[NFA_ALPHABET_SIZE];
+    for (int state = 0; state < nfa->numStates; state++) {
+        const struct Edges* out = &nfa->transitions[state];
+        for (int i = 0; i < out->count; i++) {
+            const struct Edge* edge = &out->edges[i];
+            memset(in, 0, sizeof(in));
+            if (edge->kind == EDGE_ALL_BUT) {
+                in[edge->sym] = true;
+            } else if (edge->kind == EDGE_SYM) {
+                // All the symbols leading to this edge's dst, handled once per dst
+                bool first = true;
+                for (int j = 0; j < out->count; j++) {
+                    const struct Edge* other = &out->edges[j];
+                    if (other->kind == EDGE_SYM && other->dst == edge->dst) {
+                        if (j < i) {
+                            first = false;
+                            break;
+                        }
+                        in[other->sym] = true;
+                    }
+                }
+                if (!first) {
+                    continue;
+                }
+            } else {
+                continue;
+            }
+            n = refine_classes(classes, n, in);
+        }
+    }
+    return n;
+}
+
+// Note the bytes on which the initial set of states goes anywhere but (only)
+// back to itself, if there are at most SIMD_FIND_MAX of them. Only used by
+// NFAs with at most 64 states, whose set of active states is a single word.
+static void NFA_build_skip(NFA nfa) {
+    nfa->skipCount = -1;
+    if (nfa->words != 1) {
+        return;
+    }
+    uint64_t self = nfa->initialMask[0];
+    int count = 0;
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+        const uint64_t* row = nfa->successors + (size_t)nfa->classes[sym] * nfa->numStates;
+        uint64_t next = 0;
+        for (uint64_t active = self; active != 0; active &= active - 1) {
+            next |= row[BitSet_lowest(active)];
+        }
+        if (next != self) {
+            if (count == SIMD_FIND_MAX) {
+                return;
+            }
+            nfa->skipBytes[count++] = (uint8_t)sym;
+        }
+    }
+    nfa->skipCount = count;
+}
+
+// Replace the given set of states with the union of their epsilon closures,
+// using scratch (the same size) to build it
+static void NFA_close(NFA nfa, uint64_t* set, uint64_t* scratch) {
+    int words = nfa->words;
+    memset(scratch, 0, words * sizeof(uint64_t));
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = set[w]; bits != 0; bits &= bits - 1) {
+            const uint64_t* closure = nfa->closures + (size_t)(w * 64 + BitSet_lowest(bits)) * words;
+            for (int k = 0; k < words; k++) {
+                scratch[k] |= closure[k];
+            }
+        }
+    }
+    memcpy(set, scratch, words * sizeof(uint64_t));
+}
+
+// Build the successor masks: for every symbol class and state, the set of next
+// states as a bit vector, so a simulation step is just ORing together the
+// masks of the active states. Epsilon closures are folded into the masks (and
+// the initial set), so every set of active states is already closed and a
+// step costs the same with epsilon edges as without.
+static void NFA_build_masks(NFA nfa) {
+    int n = nfa->numStates;
+    int words = nfa->words;
+    int nclasses = NFA_get_classes(nfa, nfa->classes);
+    nfa->successors = (uint64_t*)calloc((size_t)nclasses * n * words, sizeof(uint64_t));
+    nfa->acceptMask = (uint64_t*)calloc(words, sizeof(uint64_t));
+    for (int state = 0; state < n; state++) {
+        const struct Edges* out = &nfa->transitions[state];
+        for (int i = 0; i < out->count; i++) {
+            const struct Edge* edge = &out->edges[i];
+            uint64_t bit = (uint64_t)1 << (edge->dst % 64);
+            for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+                if (edge_matches(edge, (unsigned char)sym)) {
+                    size_t cls = nfa->classes[sym];
+                    nfa->successors[(cls * n + state) * words + edge->dst / 64] |= bit;
+                }
+            }
+        }
+        if (NFA_get_accepting(nfa, state)) {
+            nfa->acceptMask[state / 64] |= (uint64_t)1 << (state % 64);
+        }
+    }
+    nfa->initialMask = (uint64_t*)calloc(words, sizeof(uint64_t));
+    nfa->initialMask[nfa->initialState / 64] = (uint64_t)1 << (nfa->initialState % 64);
+    if (nfa->epsilons > 0) {
+        if (nfa->closures == NULL) {
+            NFA_build_closures(nfa);
+        }
+        uint64_t* closed = (uint64_t*)malloc(words * sizeof(uint64_t));
+        for (size_t mask = 0; mask < (size_t)nclasses * n; mask++) {
+            NFA_close(nfa, nfa->successors + mask * words, closed);
+        }
+        NFA_close(nfa, nfa->initialMask, closed);
+        free(closed);
+    }
+    NFA_build_skip(nfa);
+}
+
+// Advance the set of states in current (nfa->words words) over length bytes of
+// input, using scratch (the same size) as the other half of a double buffer.
+// Return false as soon as the set becomes empty. NFAs with at most 64 states
+// keep the whole set in one word, and skip over input that leaves the initial
+// state on its own where they can.
+static bool NFA_advance(NFA nfa, uint64_t* current, uint64_t* scratch, const uint8_t* input, size_t length) {
+    int n = nfa->numStates;
+    int words = nfa->words;
+    if (words == 1) {
+        uint64_t set = current[0];
+        uint64_t skipSet = nfa->skipCount == -1 ? 0 : nfa->initialMask[0];
+        size_t resume = 0;      // Don't skip before here
+        int misses = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (set == skipSet && i >= resume) {
+                size_t skip = SIMD_find_any(nfa->skipBytes, nfa->skipCount, input + i, length - i);
+                i += skip;
+                if (i == length) {
+                    break;
+                }
+                if (skip >= SIMD_SKIP_MIN) {
+                    misses = 0;
+                } else if (++misses == SIMD_SKIP_MISSES) {
+                    misses = 0;
+                    resume = i + SIMD_SKIP_BACKOFF;
+                }
+            }
+            const uint64_t* row = nfa->successors + (size_t)nfa->classes[input[i]] * n;
+            uint64_t next = 0;
+            for (uint64_t active = set; active != 0; active &= active - 1) {
+                next |= row[BitSet_lowest(active)];
+            }
+            set = next;
+            if (set == 0) {
+                break;
+            }
+        }
+        current[0] = set;
+        return set != 0;
+    }
+    uint64_t* sets = current;
+    uint64_t* next = scratch;
+    bool alive = true;
+    for (size_t i = 0; alive && i < length; i++) {
+        const uint64_t* row = nfa->successors + (size_t)nfa->classes[input[i]] * n * words;
+        memset(next, 0, words * sizeof(uint64_t));
+        for (int w = 0; w < words; w++) {
+            for (uint64_t active = current[w]; active != 0; active &= active - 1) {
+                const uint64_t* mask = row + (size_t)(w * 64 + BitSet_lowest(active)) * words;
+                for (int k = 0; k < words; k++) {
+                    next[k] |= mask[k];
+                }
+            }
+        }
+        alive = false;
+        for (int k = 0; k < words; k++) {
+            alive |= next[k] != 0;
+        }
+        uint64_t* swap = current;
+        current = next;
+        next = swap;
+    }
+    if (current != sets) {
+        memcpy(sets, current, words * sizeof(uint64_t));
+    }
+    return alive;
+}
+
+// Return true if the given set of states contains an accepting state
+static bool NFA_accepts(NFA nfa, const uint64_t* current) {
+    for (int k = 0; k < nfa->words; k++) {
+        if ((current[k] & nfa->acceptMask[k]) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Build the tables the given NFA is run with, if they aren't built already.
+void NFA_prepare(NFA nfa) {
+    if (nfa->successors == NULL) {
+        NFA_build_masks(nfa);
+    }
+}
+
+// Run the given NFA on length bytes of input (which may contain any byte values,
+// including NUL), and return true if it accepts the input, otherwise false.
+bool NFA_execute_buf(NFA nfa, const uint8_t* input, size_t length) {
+    if (nfa->successors == NULL) {
+        NFA_build_masks(nfa);
+    }
+    // Both state sets are allocated once up front, never inside the loop
+    uint64_t small[2];
+    uint64_t* sets = nfa->words == 1 ? small : (uint64_t*)malloc(2 * nfa->words * sizeof(uint64_t));
+    memcpy(sets, nfa->initialMask, nfa->words * sizeof(uint64_t));
+    bool result = NFA_advance(nfa, sets, sets + nfa->words, input, length) && NFA_accepts(nfa, sets);
+    if (sets != small) {
+        free(sets);
+    }
+    return result;
 }
 
 // Run the given NFA on the given input string, and return true if it accepts
 // the input, otherwise false.
 bool NFA_execute(NFA nfa, char *input){
-    IntHashSet currStates = new_IntHashSet(nfa->numStates);
-    IntHashSet_insert(currStates, nfa->initialState);
-    for (int i = 0; input[i] != '\0'; i++) {
-        IntHashSet nextStates = new_IntHashSet(nfa->numStates);
-        for (int j = 0; j < nfa->numStates; j++){
-            if (IntHashSet_lookup(currStates, j)){
-                IntHashSet transitions = NFA_get_transitions(nfa, j, input[i]);
-                IntHashSet_union(nextStates, transitions);
+    return NFA_execute_buf(nfa, (const uint8_t*)input, strlen(input));
+}
+
+// State of an NFA run over input that arrives in pieces: the set of active
+// states and the scratch set NFA_advance needs, in one allocation.
+struct NFAStream {
+    NFA nfa;
+    bool alive;         // False once no states are active
+    uint64_t sets[];    // Active states, then scratch (nfa->words words each)
+};
+
+// Start running the given NFA over a stream of input chunks.
+NFAStream NFA_stream_begin(NFA nfa) {
+    return NFA_stream_begin_from(nfa, &nfa->initialState, 1);
+}
+
+// Start running the given NFA over a stream of input chunks, with the n given
+// states active instead of the initial state.
+NFAStream NFA_stream_begin_from(NFA nfa, const int* states, int n) {
+    if (nfa->successors == NULL) {
+        NFA_build_masks(nfa);
+    }
+    NFAStream stream = (NFAStream)malloc(sizeof(struct NFAStream) + 2 * nfa->words * sizeof(uint64_t));
+    stream->nfa = nfa;
+    stream->alive = n > 0;
+    memset(stream->sets, 0, nfa->words * sizeof(uint64_t));
+    for (int i = 0; i < n; i++) {
+        stream->sets[states[i] / 64] |= (uint64_t)1 << (states[i] % 64);
+    }
+    if (nfa->epsilons > 0) {
+        NFA_close(nfa, stream->sets, stream->sets + nfa->words);
+    }
+    return stream;
+}
+
+// Continue the given stream with the next length bytes of input. Return false
+// if the input has already been rejected, in which case the rest can be skipped.
+bool NFA_stream_feed(NFAStream stream, const uint8_t* chunk, size_t length) {
+    if (stream->alive) {
+        stream->alive = NFA_advance(stream->nfa, stream->sets, stream->sets + stream->nfa->words, chunk, length);
+    }
+    return stream->alive;
+}
+
+// Return true if the input fed to the given stream so far is accepted.
+bool NFA_stream_accepting(NFAStream stream) {
+    return stream->alive && NFA_accepts(stream->nfa, stream->sets);
+}
+
+// Finish the given stream, freeing it, and return true if the NFA accepts the input fed to it.
+bool NFA_stream_end(NFAStream stream) {
+    bool result = NFA_stream_accepting(stream);
+    free(stream);
+    return result;
+}
+
+// Find the shortest accepted prefix of the given input and store its length in *end.
+bool NFA_first_accept(NFA nfa, const uint8_t* input, size_t length, size_t* end) {
+    if (nfa->successors == NULL) {
+        NFA_build_masks(nfa);
+    }
+    uint64_t small[2];
+    uint64_t* sets = nfa->words == 1 ? small : (uint64_t*)malloc(2 * nfa->words * sizeof(uint64_t));
+    memcpy(sets, nfa->initialMask, nfa->words * sizeof(uint64_t));
+    bool found = NFA_accepts(nfa, sets);
+    size_t i = 0;
+    while (!found && i < length && NFA_advance(nfa, sets, sets + nfa->words, input + i, 1)) {
+        i += 1;
+        found = NFA_accepts(nfa, sets);
+    }
+    if (sets != small) {
+        free(sets);
+    }
+    *end = i;
+    return found;
+}
+
+// Working space for finding matches, allocated once per search. As in dfa.c,
+// runs from every start position still in the running are followed together,
+// keeping only the earliest start that has reached each NFA state.
+struct NFAFinder {
+    NFA nfa;
+    int* states;            // Active states
+    int* next;              // Double buffer for states
+    size_t* startOf;        // Earliest start that reached each state, or SIZE_MAX
+    size_t* nextStartOf;    // Double buffer for startOf
+    bool* absorbing;        // States that go only to themselves on every input
+    uint8_t viable[SIMD_FIND_MAX];  // Bytes the initial state goes anywhere on,
+    int viableCount;                // if there are few enough of them, or -1
+};
+
+static void NFAFinder_init(struct NFAFinder* f, NFA nfa) {
+    if (nfa->successors == NULL) {
+        NFA_build_masks(nfa);
+    }
+    int n = nfa->numStates;
+    f->nfa = nfa;
+    f->states = (int*)malloc(n * sizeof(int));
+    f->next = (int*)malloc(n * sizeof(int));
+    f->startOf = (size_t*)malloc(n * sizeof(size_t));
+    f->nextStartOf = (size_t*)malloc(n * sizeof(size_t));
+    f->absorbing = (bool*)malloc(n * sizeof(bool));
+    int nclasses = 0;
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+        if (nfa->classes[sym] >= nclasses) {
+            nclasses = nfa->classes[sym] + 1;
+        }
+    }
+    for (int state = 0; state < n; state++) {
+        f->startOf[state] = SIZE_MAX;
+        f->nextStartOf[state] = SIZE_MAX;
+        f->absorbing[state] = true;
+        for (int cls = 0; cls < nclasses && f->absorbing[state]; cls++) {
+            const uint64_t* mask = nfa->successors + ((size_t)cls * n + state) * nfa->words;
+            for (int w = 0; w < nfa->words; w++) {
+                uint64_t self = w == state / 64 ? (uint64_t)1 << (state % 64) : 0;
+                if (mask[w] != self) {
+                    f->absorbing[state] = false;
+                }
             }
         }
-        IntHashSet_free(currStates);
-        currStates = nextStates;
     }
-    bool result = false;
-    for (int i = 0; i < nfa->numStates; i++) {
-        if (IntHashSet_lookup(currStates, i) && NFA_get_accepting(nfa, i)) {
-            result = true;
+    f->viableCount = 0;
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE && f->viableCount != -1; sym++) {
+        const uint64_t* row = nfa->successors + (size_t)nfa->classes[sym] * n * nfa->words;
+        bool any = false;
+        for (int w = 0; w < nfa->words; w++) {
+            for (uint64_t bits = nfa->initialMask[w]; bits != 0; bits &= bits - 1) {
+                const uint64_t* mask = row + (size_t)(w * 64 + BitSet_lowest(bits)) * nfa->words;
+                for (int k = 0; k < nfa->words; k++) {
+                    any |= mask[k] != 0;
+                }
+            }
+        }
+        if (any) {
+            if (f->viableCount == SIMD_FIND_MAX) {
+                f->viableCount = -1;
+            } else {
+                f->viable[f->viableCount++] = (uint8_t)sym;
+            }
+        }
+    }
+}
+
+static void NFAFinder_free(struct NFAFinder* f) {
+    free(f->states);
+    free(f->next);
+    free(f->startOf);
+    free(f->nextStartOf);
+    free(f->absorbing);
+}
+
+// Find the leftmost-longest match starting at or after from.
+static bool NFAFinder_find(struct NFAFinder* f, const uint8_t* input, size_t length, size_t from, Match* match) {
+    NFA nfa = f->nfa;
+    int numStates = nfa->numStates;
+    int words = nfa->words;
+    bool initialAccepting = NFA_accepts(nfa, nfa->initialMask);
+    int n = 0;
+    bool found = false;
+    for (size_t i = from; ; i++) {
+        if (!found) {
+            // With no runs left, a match can only start at a byte the initial state goes somewhere on
+            if (n == 0 && !initialAccepting && f->viableCount != -1) {
+                i += SIMD_find_any(f->viable, f->viableCount, input + i, length - i);
+            }
+            for (int w = 0; w < words; w++) {
+                for (uint64_t bits = nfa->initialMask[w]; bits != 0; bits &= bits - 1) {
+                    int s = w * 64 + BitSet_lowest(bits);
+                    if (f->startOf[s] == SIZE_MAX) {
+                        f->startOf[s] = i;
+                        f->states[n++] = s;
+                    }
+                }
+            }
+        }
+        // Accepting states end matches here
+        bool settled = false;   // Whether the match's run can't leave an accepting state
+        for (int k = 0; k < n; k++) {
+            int s = f->states[k];
+            size_t start = f->startOf[s];
+            if ((nfa->acceptMask[s / 64] >> (s % 64)) & 1) {
+                if (!found || start < match->start || (start == match->start && i > match->end)) {
+                    match->start = start;
+                    match->end = i;
+                    found = true;
+                    settled = false;
+                }
+                settled |= start == match->start && f->absorbing[s];
+            }
+        }
+        if (found) {
+            // Runs that started after the match can't beat it
+            int kept = 0;
+            bool earlier = false;
+            for (int k = 0; k < n; k++) {
+                int s = f->states[k];
+                if (f->startOf[s] <= match->start) {
+                    earlier |= f->startOf[s] < match->start;
+                    f->states[kept++] = s;
+                } else {
+                    f->startOf[s] = SIZE_MAX;
+                }
+            }
+            n = kept;
+            // The match goes on to the end, unless an earlier run beats it
+            if (settled && !earlier) {
+                match->end = length;
+                break;
+            }
+        }
+        if (n == 0 || i == length) {
             break;
         }
+        // Step every run over input[i]
+        const uint64_t* row = nfa->successors + (size_t)nfa->classes[input[i]] * numStates * words;
+        int m = 0;
+        for (int k = 0; k < n; k++) {
+            int s = f->states[k];
+            size_t start = f->startOf[s];
+            f->startOf[s] = SIZE_MAX;
+            const uint64_t* mask = row + (size_t)s * words;
+            for (int w = 0; w < words; w++) {
+                for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+                    int t = w * 64 + BitSet_lowest(bits);
+                    if (f->nextStartOf[t] == SIZE_MAX) {
+                        f->next[m++] = t;
+                        f->nextStartOf[t] = start;
+                    } else if (start < f->nextStartOf[t]) {
+                        f->nextStartOf[t] = start;
+                    }
+                }
+            }
+        }
+        int* states = f->states;
+        f->states = f->next;
+        f->next = states;
+        size_t* startOf = f->startOf;
+        f->startOf = f->nextStartOf;
+        f->nextStartOf = startOf;
+        n = m;
     }
-    IntHashSet_free(currStates);
-    return result;
+    for (int k = 0; k < n; k++) {
+        f->startOf[f->states[k]] = SIZE_MAX;
+    }
+    return found;
+}
+
+// Find the leftmost-longest match in the given input.
+bool NFA_find(NFA nfa, const uint8_t* input, size_t length, Match* match) {
+    struct NFAFinder finder;
+    NFAFinder_init(&finder, nfa);
+    bool found = NFAFinder_find(&finder, input, length, 0, match);
+    NFAFinder_free(&finder);
+    return found;
+}
+
+// Call func on each non-overlapping leftmost-longest match in the given input
+// and return the number of matches.
+size_t NFA_find_all(NFA nfa, const uint8_t* input, size_t length, MatchCallback func, void* ctx) {
+    struct NFAFinder finder;
+    NFAFinder_init(&finder, nfa);
+    size_t count = 0;
+    size_t from = 0;
+    Match match;
+    while (from <= length && NFAFinder_find(&finder, input, length, from, &match)) {
+        count += 1;
+        if (!func(match, ctx)) {
+            break;
+        }
+        from = match.end > match.start ? match.end : match.end + 1;
+    }
+    NFAFinder_free(&finder);
+    return count;
+}
+
+// Destination for NFA_find_all_array
+struct MatchArray {
+    Match* matches;
+    size_t count;
+    size_t max;
+};
+
+static bool store_match(Match match, void* ctx) {
+    struct MatchArray* array = (struct MatchArray*)ctx;
+    array->matches[array->count++] = match;
+    return array->count < array->max;
+}
+
+// Store the first max non-overlapping leftmost-longest matches in matches and
+// return how many there were.
+size_t NFA_find_all_array(NFA nfa, const uint8_t* input, size_t length, Match* matches, size_t max) {
+    struct MatchArray array = { matches, 0, max };
+    if (max > 0) {
+        NFA_find_all(nfa, input, length, store_match, &array);
+    }
+    return array.count;
 }
 
 // Runs any NFA in a “Read-Eval-Print Loop” (REPL)
+// Lines of any length are read in pieces and fed to a NFAStream as they arrive.
 void NFA_repl(NFA *nfa) {
     while (1) {
         char input[51];
+        char shown[51];     // Start of the line, for echoing it back
         printf("\tEnter Input (\"quit\" to Quit): ");
-        if (fgets(input, sizeof(input), stdin) == NULL) {
+        NFAStream stream = NFA_stream_begin(*nfa);
+        bool first = true;
+        bool complete = false;
+        bool quit = false;
+        bool whole = true;  // Whether the line fit in the first piece (the rest is at most its newline)
+        while (!complete && fgets(input, sizeof(input), stdin) != NULL) {
+            size_t length = strcspn(input, "\n");
+            complete = input[length] == '\n';
+            if (first) {
+                memcpy(shown, input, length);
+                shown[length] = '\0';
+                quit = complete && strcmp(shown, "quit") == 0;
+            } else if (length > 0) {
+                whole = false;
+            }
+            NFA_stream_feed(stream, (const uint8_t*)input, length);
+            first = false;
+        }
+        bool result = NFA_stream_end(stream);
+        if (first) {
             printf("Error reading input\n");
             break;
         }
-        input[strcspn(input, "\n")] = '\0';
-        if (strcmp(input, "quit") == 0) {
+        if (quit) {
             break;
         }
-        bool result = NFA_execute(*nfa, input);
-        printf("\tResult for \"%s\": %s\n", input, result ? "true" : "false");
+        printf("\tResult for \"%s%s\": %s\n", shown, whole ? "" : "...",
+               result ? "true" : "false");
     }
     printf("\n");
 }
@@ -168,19 +903,28 @@ void NFA_print(NFA nfa) {
     for (int i = 0; i < nfa->numStates; i++) {
         printf("%d ", i);
     }
-    printf("\nInput Alphabet: ASCII Characters 1-128\nTransition Table:\n");
+    printf("\nInput Alphabet: Bytes 0-255\nTransitions:\n");
     for (int i = 0; i < nfa->numStates; i++) {
         printf("State %d [", i);
-        for (int sym = 0; sym < 128; sym++) {
-            IntHashSet* transitions = nfa->transitions[i]; // Change here
-            printf("%d ", IntHashSet_lookup(*transitions, sym) ? 1 : 0);
+        const struct Edges* out = &nfa->transitions[i];
+        for (int j = 0; j < out->count; j++) {
+            const struct Edge* edge = &out->edges[j];
+            if (edge->kind == EDGE_SYM) {
+                printf(" '%c'->%d", edge->sym, edge->dst);
+            } else if (edge->kind == EDGE_ALL_BUT) {
+                printf(" not '%c'->%d", edge->sym, edge->dst);
+            } else if (edge->kind == EDGE_EPSILON) {
+                printf(" epsilon->%d", edge->dst);
+            } else {
+                printf(" any->%d", edge->dst);
+            }
         }
-        printf("]\n");
+        printf(" ]\n");
     }
     printf("Initial State: 0\nAccepting States:\n");
-    IntHashSetIterator iterator = IntHashSet_iterator(nfa->acceptingStates);
-    while (IntHashSetIterator_hasNext(iterator)) {
-        int state = IntHashSetIterator_next(iterator);
+    SetIterator iterator = Set_iterator(nfa->acceptingStates);
+    while (SetIterator_hasNext(iterator)) {
+        int state = SetIterator_next(iterator);
         printf("%d\n", state);
     }
     free(iterator);
@@ -210,7 +954,6 @@ NFA* NFA_for_contains_ath(){
     NFA_add_transition_all(*nfa, 2, 0);
     NFA_add_transition_all(*nfa, 3, 3);
     NFA_set_accepting(*nfa, 3, true);
-    setTest(*nfa);
     return nfa;
 }
 
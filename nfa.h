@@ -8,7 +8,15 @@
 #define _nfa_h
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "Set.h"
+#include "match.h"
+
+/**
+ * Number of input symbols: NFAs run over arbitrary bytes.
+ */
+#define NFA_ALPHABET_SIZE 256
 
 /**
  * The data structure used to represent a nondeterministic finite automaton.
@@ -32,12 +40,40 @@ extern void NFA_free(NFA nfa);
  */
 extern int NFA_get_size(NFA nfa);
 
+/**
+ * Return the initial state of the given NFA.
+ */
+extern int NFA_get_initialState(NFA nfa);
+
 /**
  * Return the set of next states specified by the given NFA's transition
  * function from the given state on input symbol sym.
+ * The set belongs to the NFA and is only valid until the next call.
  */
 extern Set NFA_get_transitions(NFA nfa, int state, char sym);
 
+/**
+ * Add to the given set the next states specified by the given NFA's
+ * transition function from the given state on input symbol sym, along
+ * with every state reachable from them by epsilon transitions.
+ */
+extern void NFA_union_transitions(NFA nfa, int state, char sym, Set states);
+
+/**
+ * Add the given state and every state reachable from it by epsilon
+ * transitions (its epsilon closure) to the given set. The closures are
+ * worked out once, the first time they are needed.
+ */
+extern void NFA_union_closure(NFA nfa, int state, Set states);
+
+/**
+ * Group the 256 input symbols into classes that every state of the given
+ * NFA treats the same way. Store the class of each symbol in classes
+ * (which must have room for NFA_ALPHABET_SIZE entries) and return the
+ * number of classes.
+ */
+extern int NFA_get_classes(NFA nfa, unsigned char* classes);
+
 /**
  * For the given NFA, add the state dst to the set of next states from
  * state src on input symbol sym.
@@ -54,6 +90,17 @@ extern void NFA_add_transition_str(NFA nfa, int src, char *str, int dst);
  */
 extern void NFA_add_transition_all(NFA nfa, int src, int dst);
 
+/**
+ * Add a transition for the given NFA for each input symbol except sym.
+ */
+extern void NFA_add_transition_all_but(NFA nfa, int src, char sym, int dst);
+
+/**
+ * Add an epsilon transition for the given NFA from state src to state dst:
+ * whenever src is active, dst is too, without reading any input.
+ */
+extern void NFA_add_epsilon(NFA nfa, int src, int dst);
+
 /**
  * Set whether the given NFA's state is accepting or not.
  */
@@ -64,12 +111,99 @@ extern void NFA_set_accepting(NFA nfa, int state, bool value);
  */
 extern bool NFA_get_accepting(NFA nfa, int state);
 
+/**
+ * Build the tables the given NFA is run with (which are otherwise built the
+ * first time it is run, and again after it changes), so that it can then be
+ * run by several threads at once.
+ */
+extern void NFA_prepare(NFA nfa);
+
+/**
+ * Return a new NFA that accepts the strings accepted by any of the count
+ * given NFAs, which are not modified. It has a new initial state 0, and
+ * state s of nfas[k] becomes state offsets[k] + s (offsets must have room
+ * for count ints).
+ */
+extern NFA NFA_union(NFA* nfas, int count, int* offsets);
+
 /**
  * Run the given NFA on the given input string, and return true if it accepts
  * the input, otherwise false.
  */
 extern bool NFA_execute(NFA nfa, char *input);
 
+/**
+ * Run the given NFA on the given length bytes of input, which may hold any
+ * byte values (including NUL), and return true if it accepts the input,
+ * otherwise false. Stops reading as soon as no states are active.
+ */
+extern bool NFA_execute_buf(NFA nfa, const uint8_t* input, size_t length);
+
+/**
+ * Find the shortest prefix of the given input that the NFA accepts, and
+ * store its length in *end. Returns false if no prefix is accepted.
+ */
+extern bool NFA_first_accept(NFA nfa, const uint8_t* input, size_t length, size_t* end);
+
+/**
+ * Find the leftmost-longest match in the given input: of the parts of the
+ * input that the NFA accepts, the one that starts first, and of those the
+ * longest. Returns false if there is none. Takes one pass over the input,
+ * keeping only the earliest start that has reached each state.
+ */
+extern bool NFA_find(NFA nfa, const uint8_t* input, size_t length, Match* match);
+
+/**
+ * Call the given function on each of the non-overlapping leftmost-longest
+ * matches in the given input, in order (after each match, the search
+ * continues from its end, or one byte further for an empty match). Returns
+ * the number of matches. Nothing is allocated per match.
+ */
+extern size_t NFA_find_all(NFA nfa, const uint8_t* input, size_t length, MatchCallback func, void* ctx);
+
+/**
+ * Like NFA_find_all, but store the first max matches in the given array.
+ * Returns the number stored.
+ */
+extern size_t NFA_find_all_array(NFA nfa, const uint8_t* input, size_t length, Match* matches, size_t max);
+
+/**
+ * A NFAStream runs a NFA over input that arrives in chunks (socket reads,
+ * blocks of a file), carrying its state from one chunk to the next so the
+ * input never has to be gathered into one buffer. Chunks are read in place.
+ */
+typedef struct NFAStream* NFAStream;
+
+/**
+ * Start running the given NFA over a stream of input chunks. The NFA must
+ * not be modified or freed until the stream is ended.
+ */
+extern NFAStream NFA_stream_begin(NFA nfa);
+
+/**
+ * Like NFA_stream_begin, but start with the n given states active instead
+ * of just the initial state (to carry on a run begun some other way).
+ */
+extern NFAStream NFA_stream_begin_from(NFA nfa, const int* states, int n);
+
+/**
+ * Continue the given stream with the next length bytes of input. Returns
+ * false once the input can no longer be accepted, so the caller may stop
+ * feeding it.
+ */
+extern bool NFA_stream_feed(NFAStream stream, const uint8_t* chunk, size_t length);
+
+/**
+ * Return true if the input fed to the given stream so far is accepted.
+ */
+extern bool NFA_stream_accepting(NFAStream stream);
+
+/**
+ * Finish and free the given stream, returning true if the NFA accepts all
+ * the input that was fed to it.
+ */
+extern bool NFA_stream_end(NFAStream stream);
+
 /**
  * Print the given NFA to System.out.
  */
@@ -85,11 +219,7 @@ extern NFA* NFA_for_conference();
 
 extern int getStates(NFA this);
 
-extern IntHashSet getAcceptingStates (NFA nfa);
-
-extern bool getTest(NFA this);
-
-extern bool setTest (NFA this);
+extern Set getAcceptingStates (NFA nfa);
 
 
 #endif
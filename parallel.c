@@ -0,0 +1,347 @@
+//
+// File: parallel.c
+// Created: 10/17/2026
+//
+// Batch matching on several cores. The input is still read one block at a
+// time; each block is cut at line boundaries into one shard per worker, the
+// workers record a result byte per line of their shard, and the calling
+// thread then writes the results shard by shard, so the output is in input
+// order without any sorting.
+//
+// A single large input is run by splitting it instead, and stitching the
+// per-chunk state maps back together (DFA_execute_parallel).
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "parallel.h"
+
+// The lines of one block that a single worker evaluates
+struct Shard {
+    const uint8_t* data;
+    size_t length;
+    bool* results;      // One per line
+    size_t count;
+    size_t capacity;
+};
+
+struct Pool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;   // Signalled when a new block is handed out
+    pthread_cond_t done;    // Signalled when the last shard is finished
+    unsigned long block;    // Incremented for every block handed out
+    int pending;            // Shards of the current block not yet finished
+    bool quit;
+    BatchMatcher matcher;
+    BatchManyMatcher many;
+    void* automaton;
+    struct Shard* shards;
+};
+
+struct Worker {
+    struct Pool* pool;
+    int index;
+};
+
+static void* Worker_run(void* arg) {
+    struct Worker* worker = (struct Worker*)arg;
+    struct Pool* pool = worker->pool;
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->block == seen && !pool->quit) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->block;
+        pthread_mutex_unlock(&pool->lock);
+
+        struct Shard* shard = &pool->shards[worker->index];
+        shard->count = Batch_evaluate(pool->matcher, pool->many, pool->automaton, shard->data,
+                                      shard->length, &shard->results, &shard->capacity);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Cut the given block into nshards pieces of about the same size, each
+// ending just after a newline (or at the end of the block)
+static void split_block(const uint8_t* data, size_t length, struct Shard* shards, int nshards) {
+    size_t start = 0;
+    for (int i = 0; i < nshards; i++) {
+        size_t end = length;
+        if (i < nshards - 1) {
+            end = start + (length - start) / (nshards - i);
+            const uint8_t* newline = memchr(data + end, '\n', length - end);
+            end = newline == NULL ? length : (size_t)(newline - data) + 1;
+        }
+        if (end < start) {
+            end = start;
+        }
+        shards[i].data = data + start;
+        shards[i].length = end - start;
+        start = end;
+    }
+}
+
+int Batch_run_parallel(FILE* in, FILE* out, BatchMode mode,
+                       BatchMatcher matcher, BatchManyMatcher many, void* automaton, int nthreads) {
+    if (nthreads <= 1) {
+        return Batch_run(in, out, mode, matcher, many, automaton);
+    }
+    struct Pool pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.start, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pool.block = 0;
+    pool.pending = 0;
+    pool.quit = false;
+    pool.matcher = matcher;
+    pool.many = many;
+    pool.automaton = automaton;
+    pool.shards = (struct Shard*)calloc(nthreads, sizeof(struct Shard));
+
+    int status = 0;
+    pthread_t* threads = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+    struct Worker* workers = (struct Worker*)malloc(nthreads * sizeof(struct Worker));
+    int started = 0;
+    for (; started < nthreads; started++) {
+        workers[started].pool = &pool;
+        workers[started].index = started;
+        int error = pthread_create(&threads[started], NULL, Worker_run, &workers[started]);
+        if (error != 0) {
+            fprintf(stderr, "can't start worker thread: %s\n", strerror(error));
+            status = -1;
+            break;
+        }
+    }
+
+    BatchReader reader = new_BatchReader(in);
+    BatchWriter writer = new_BatchWriter(out, mode);
+    const uint8_t* data;
+    size_t length;
+    while (status == 0 && BatchReader_next(reader, &data, &length)) {
+        split_block(data, length, pool.shards, nthreads);
+        pthread_mutex_lock(&pool.lock);
+        pool.pending = nthreads;
+        pool.block += 1;
+        pthread_cond_broadcast(&pool.start);
+        while (pool.pending > 0) {
+            pthread_cond_wait(&pool.done, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+        for (int i = 0; i < nthreads; i++) {
+            struct Shard* shard = &pool.shards[i];
+            Batch_write(writer, shard->data, shard->length, shard->results, shard->count);
+        }
+    }
+    if (ferror(in)) {
+        fprintf(stderr, "error reading input: %s\n", strerror(errno));
+        status = -1;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    BatchReader_free(reader);
+    if (BatchWriter_finish(writer) != 0) {
+        fprintf(stderr, "error writing output: %s\n", strerror(errno));
+        status = -1;
+    }
+    for (int i = 0; i < nthreads; i++) {
+        free(pool.shards[i].results);
+    }
+    free(pool.shards);
+    free(threads);
+    free(workers);
+    pthread_cond_destroy(&pool.start);
+    pthread_cond_destroy(&pool.done);
+    pthread_mutex_destroy(&pool.lock);
+    return status;
+}
+
+// Bytes a chunk is run over before its runs are first merged; the interval
+// then doubles after each merge, up to MERGE_INTERVAL
+#define MERGE_FIRST 16
+#define MERGE_INTERVAL 4096
+
+// Running a chunk from more than one state may cost at most 1/MAX_SPECULATION
+// of a sequential run over it before the chunk gives up
+#define MAX_SPECULATION 4
+
+// Inputs with less than this much per thread are just run sequentially
+#define MIN_CHUNK (1 << 16)
+
+// One chunk of the input for DFA_execute_parallel
+struct Chunk {
+    DFA dfa;
+    const uint8_t* data;
+    size_t length;
+    int nstarts;        // Start from the initial state only (1), or from all states
+    int limit;          // Give up if more runs than this are left after merging
+    bool mapped;        // False if it gave up
+    int* map;           // map[i]: state reached from start state i, or -1
+};
+
+// Run the given chunk from each of its start states. Runs that end up in
+// the same state stay together from then on, so every so often the distinct
+// current states are collected and only those are advanced. The first merge
+// comes after only a few bytes, since most runs merge quickly and until then
+// every start state costs a transition per byte. A run in a state that can't
+// be left is finished, so it isn't advanced any further, and once a single
+// run is left it is finished with DFA_advance (which can skip ahead and use
+// SIMD shuffles). If too many distinct runs are still left once the chunk
+// has spent a share of its length on them (or after MERGE_INTERVAL bytes),
+// running it from the one real start state later is cheaper, so the chunk
+// gives up instead.
+static void* Chunk_run(void* arg) {
+    struct Chunk* chunk = (struct Chunk*)arg;
+    int numStates = DFA_get_size(chunk->dfa);
+    int* current = (int*)malloc(chunk->nstarts * sizeof(int));     // Distinct current states, still moving first
+    int* owner = (int*)malloc(chunk->nstarts * sizeof(int));       // Start state -> index in current
+    int* slot = (int*)malloc(numStates * sizeof(int));             // State -> index in merged current
+    int* index = (int*)malloc(chunk->nstarts * sizeof(int));       // Index in current -> in merged
+    int n = chunk->nstarts;
+    for (int i = 0; i < n; i++) {
+        current[i] = chunk->nstarts == 1 ? DFA_get_initialState(chunk->dfa) : i;
+        owner[i] = i;
+    }
+    for (int s = 0; s < numStates; s++) {
+        slot[s] = -1;
+    }
+
+    size_t offset = 0;
+    size_t interval = MERGE_FIRST;
+    size_t work = 0;        // Transitions taken so far
+    int moving = 0;         // Runs at the front of current that can still change state
+    for (;;) {
+        // Merge runs in the same state and drop the ones that were rejected,
+        // putting the ones that can still move first
+        int merged = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int j = 0; j < n; j++) {
+                if (current[j] == -1) {
+                    index[j] = -1;
+                } else if (DFA_is_absorbing(chunk->dfa, current[j]) == (pass == 1)) {
+                    if (slot[current[j]] == -1) {
+                        slot[current[j]] = merged;
+                        current[merged++] = current[j];
+                    }
+                    index[j] = slot[current[j]];
+                }
+            }
+            if (pass == 0) {
+                moving = merged;
+            }
+        }
+        for (int i = 0; i < chunk->nstarts; i++) {
+            if (owner[i] != -1) {
+                owner[i] = index[owner[i]];
+            }
+        }
+        for (int j = 0; j < merged; j++) {
+            slot[current[j]] = -1;
+        }
+        n = merged;
+        if (offset == chunk->length || moving == 0) {
+            break;
+        }
+        if (moving > chunk->limit && (offset >= MERGE_INTERVAL || work * MAX_SPECULATION > chunk->length)) {
+            break;
+        }
+        if (moving == 1) {
+            current[0] = DFA_advance(chunk->dfa, current[0], chunk->data + offset, chunk->length - offset);
+            offset = chunk->length;
+            break;
+        }
+
+        size_t step = chunk->length - offset < interval ? chunk->length - offset : interval;
+        DFA_advance_all(chunk->dfa, current, moving, chunk->data + offset, step);
+        offset += step;
+        work += (size_t)moving * step;
+        if (interval < MERGE_INTERVAL) {
+            interval *= 2;
+        }
+    }
+
+    chunk->mapped = moving <= chunk->limit || offset == chunk->length;
+    for (int i = 0; i < chunk->nstarts && chunk->mapped; i++) {
+        chunk->map[i] = owner[i] == -1 ? -1 : current[owner[i]];
+    }
+    free(current);
+    free(owner);
+    free(slot);
+    free(index);
+    return NULL;
+}
+
+bool DFA_execute_parallel(DFA dfa, const uint8_t* input, size_t length, int nthreads) {
+    int numStates = DFA_get_size(dfa);
+    if (nthreads <= 1 || length < (size_t)nthreads * MIN_CHUNK
+        || (size_t)numStates * MERGE_FIRST * MAX_SPECULATION > length / nthreads) {
+        return DFA_execute_buf(dfa, input, length);
+    }
+    struct Chunk* chunks = (struct Chunk*)malloc(nthreads * sizeof(struct Chunk));
+    pthread_t* threads = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+    bool* started = (bool*)malloc(nthreads * sizeof(bool));
+    size_t start = 0;
+    for (int i = 0; i < nthreads; i++) {
+        size_t end = i == nthreads - 1 ? length : start + (length - start) / (nthreads - i);
+        chunks[i].dfa = dfa;
+        chunks[i].data = input + start;
+        chunks[i].length = end - start;
+        chunks[i].nstarts = i == 0 ? 1 : numStates;
+        chunks[i].limit = nthreads;
+        chunks[i].map = (int*)malloc(chunks[i].nstarts * sizeof(int));
+        start = end;
+    }
+    // The calling thread runs the first chunk itself; if a thread can't be
+    // started, its chunk is run here too
+    for (int i = 1; i < nthreads; i++) {
+        started[i] = pthread_create(&threads[i], NULL, Chunk_run, &chunks[i]) == 0;
+    }
+    Chunk_run(&chunks[0]);
+    for (int i = 1; i < nthreads; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            Chunk_run(&chunks[i]);
+        }
+    }
+
+    // Compose the chunks' maps, running any chunk that gave up from the
+    // state the ones before it lead to
+    int state = chunks[0].map[0];
+    for (int i = 1; i < nthreads && state != -1; i++) {
+        if (chunks[i].mapped) {
+            state = chunks[i].map[state];
+        } else {
+            state = DFA_advance(dfa, state, chunks[i].data, chunks[i].length);
+        }
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+        free(chunks[i].map);
+    }
+    free(chunks);
+    free(threads);
+    free(started);
+    return state != -1 && DFA_get_accepting(dfa, state);
+}
@@ -0,0 +1,45 @@
+//
+// File: parallel.h
+// Created: 10/17/2026
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+#include "batch.h"
+#include "dfa.h"
+
+/**
+ * Like Batch_run, but with the lines of each input block sharded across a
+ * pool of nthreads worker threads. The automaton is shared by all of the
+ * workers, so it must not be modified while this runs, and it must be
+ * prepared first (DFA_prepare or NFA_prepare) so that the workers don't
+ * build its tables on first use all at once. Results are written in
+ * input order, exactly as Batch_run would write them. Returns 0, or -1
+ * (after printing an error message) if reading, writing or starting the
+ * threads failed.
+ */
+extern int Batch_run_parallel(FILE* in, FILE* out, BatchMode mode,
+                              BatchMatcher matcher, BatchManyMatcher many, void* automaton, int nthreads);
+
+/**
+ * Run the given DFA on length bytes of input using nthreads threads, and
+ * return the same result as DFA_execute_buf. The input is cut into one
+ * chunk per thread. Every chunk but the first is run from all of the DFA's
+ * states at once (the state it will really start in isn't known yet),
+ * dropping runs as they merge or reach the reject state, which gives the
+ * state each start state leads to across the chunk. The chunks' maps are
+ * then composed in order, starting from the initial state. This pays off
+ * when runs merge quickly or the DFA is small: for a DFA with a few states
+ * each thread does about as much work as a single sequential run. Runs are
+ * first merged after a few bytes, then at doubling intervals. A run that
+ * reaches a state it can't leave stops there, and once a chunk is down to
+ * one run it is finished with DFA_advance. A chunk still left with more
+ * than nthreads distinct runs after a merge gives up, and is run from its
+ * real start state during the composition. A DFA with too many states for
+ * the first few bytes to be cheap is just run sequentially.
+ */
+extern bool DFA_execute_parallel(DFA dfa, const uint8_t* input, size_t length, int nthreads);
+
+#endif //PARALLEL_H
@@ -0,0 +1,457 @@
+//
+// File: regex.c
+// Created: 10/17/2026
+//
+// Regular expressions compiled with Glushkov's construction. Every
+// character or class in the pattern is a "position", and becomes one NFA
+// state, entered on exactly the bytes of that position. The parser works
+// out, for each piece of the pattern, whether it matches the empty string
+// and which positions can come first and last in a match of it; joining
+// pieces adds "follow" pairs (position p can be followed by position q),
+// each of which becomes the edges from p into q. State 0 is the initial
+// state, with edges into the positions that can start a match, and the
+// positions that can end one are accepting. Unlike Thompson's construction
+// this needs no epsilon transitions, so the NFA goes straight to the
+// bit-parallel and subset construction code.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "regex.h"
+
+// A set of input bytes
+struct CharSet {
+    uint64_t bits[NFA_ALPHABET_SIZE / 64];
+};
+
+static void CharSet_add(struct CharSet* set, int sym) {
+    set->bits[sym / 64] |= (uint64_t)1 << (sym % 64);
+}
+
+static bool CharSet_has(const struct CharSet* set, int sym) {
+    return (set->bits[sym / 64] >> (sym % 64)) & 1;
+}
+
+static void CharSet_add_range(struct CharSet* set, int lo, int hi) {
+    for (int sym = lo; sym <= hi; sym++) {
+        CharSet_add(set, sym);
+    }
+}
+
+static void CharSet_add_all(struct CharSet* set, const struct CharSet* other) {
+    for (int w = 0; w < NFA_ALPHABET_SIZE / 64; w++) {
+        set->bits[w] |= other->bits[w];
+    }
+}
+
+static void CharSet_invert(struct CharSet* set) {
+    for (int w = 0; w < NFA_ALPHABET_SIZE / 64; w++) {
+        set->bits[w] = ~set->bits[w];
+    }
+}
+
+// A growable list of positions
+struct Positions {
+    int* items;
+    int count;
+    int capacity;
+};
+
+static void Positions_add(struct Positions* list, int p) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+        list->items = (int*)realloc(list->items, list->capacity * sizeof(int));
+    }
+    list->items[list->count++] = p;
+}
+
+static void Positions_add_all(struct Positions* list, const struct Positions* other) {
+    for (int i = 0; i < other->count; i++) {
+        Positions_add(list, other->items[i]);
+    }
+}
+
+// What the construction needs to know about a piece of the pattern. The
+// positions in a piece are all its own, so first and last never overlap
+// between the pieces being joined.
+struct Fragment {
+    bool nullable;              // Matches the empty string
+    struct Positions first;     // Positions that can start a match
+    struct Positions last;      // Positions that can end one
+};
+
+static void Fragment_free(struct Fragment* fragment) {
+    free(fragment->first.items);
+    free(fragment->last.items);
+}
+
+struct Parser {
+    const char* pattern;
+    size_t length;              // Of the part between the anchors
+    size_t at;                  // Next character to read
+    const char* error;          // First error found, or NULL
+    size_t errorAt;
+    struct CharSet* sets;       // Bytes of each position (from 1)
+    int positions;
+    int capacity;
+    struct Positions follows;   // Follow pairs (p, q), as consecutive items
+};
+
+static void fail(struct Parser* parser, const char* message) {
+    if (parser->error == NULL) {
+        parser->error = message;
+        parser->errorAt = parser->at;
+    }
+}
+
+// Add a position for the given bytes and return a fragment matching just it
+static void position(struct Parser* parser, const struct CharSet* set, struct Fragment* out) {
+    parser->positions += 1;
+    if (parser->positions == parser->capacity) {
+        parser->capacity *= 2;
+        parser->sets = (struct CharSet*)realloc(parser->sets, parser->capacity * sizeof(struct CharSet));
+    }
+    parser->sets[parser->positions] = *set;
+    memset(out, 0, sizeof(*out));
+    Positions_add(&out->first, parser->positions);
+    Positions_add(&out->last, parser->positions);
+}
+
+// Every position in last can be followed by every position in first
+static void follow(struct Parser* parser, const struct Positions* last, const struct Positions* first) {
+    for (int i = 0; i < last->count; i++) {
+        for (int j = 0; j < first->count; j++) {
+            Positions_add(&parser->follows, last->items[i]);
+            Positions_add(&parser->follows, first->items[j]);
+        }
+    }
+}
+
+static bool at_end(const struct Parser* parser) {
+    return parser->at >= parser->length;
+}
+
+static char peek(const struct Parser* parser) {
+    return parser->pattern[parser->at];
+}
+
+// Return the value of the given hex digit, or -1
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Read the escape sequence after a backslash into set. Return the byte it
+// stands for, or -1 if it stands for a class (\d and so on).
+static int parse_escape(struct Parser* parser, struct CharSet* set) {
+    if (at_end(parser)) {
+        fail(parser, "trailing backslash");
+        return -1;
+    }
+    char c = parser->pattern[parser->at++];
+    int sym = (unsigned char)c;
+    switch (c) {
+        case 'n': sym = '\n'; break;
+        case 't': sym = '\t'; break;
+        case 'r': sym = '\r'; break;
+        case 'f': sym = '\f'; break;
+        case 'v': sym = '\v'; break;
+        case 'x': {
+            int hi = at_end(parser) ? -1 : hex_value(parser->pattern[parser->at]);
+            int lo = parser->at + 1 >= parser->length ? -1 : hex_value(parser->pattern[parser->at + 1]);
+            if (hi == -1 || lo == -1) {
+                fail(parser, "\\x needs two hex digits");
+                return -1;
+            }
+            parser->at += 2;
+            sym = hi * 16 + lo;
+            break;
+        }
+        case 'd': case 'D':
+        case 'w': case 'W':
+        case 's': case 'S': {
+            struct CharSet class;
+            memset(&class, 0, sizeof(class));
+            if (c == 'd' || c == 'D') {
+                CharSet_add_range(&class, '0', '9');
+            } else if (c == 'w' || c == 'W') {
+                CharSet_add_range(&class, '0', '9');
+                CharSet_add_range(&class, 'a', 'z');
+                CharSet_add_range(&class, 'A', 'Z');
+                CharSet_add(&class, '_');
+            } else {
+                CharSet_add_range(&class, '\t', '\r');
+                CharSet_add(&class, ' ');
+            }
+            if (c == 'D' || c == 'W' || c == 'S') {
+                CharSet_invert(&class);
+            }
+            CharSet_add_all(set, &class);
+            return -1;
+        }
+        default:
+            break;
+    }
+    CharSet_add(set, sym);
+    return sym;
+}
+
+// Read a character class after its opening '['
+static void parse_class(struct Parser* parser, struct CharSet* set) {
+    bool negated = false;
+    if (!at_end(parser) && peek(parser) == '^') {
+        negated = true;
+        parser->at++;
+    }
+    bool first = true;
+    while (!at_end(parser) && (peek(parser) != ']' || first)) {
+        first = false;
+        int lo;
+        char c = parser->pattern[parser->at++];
+        if (c == '\\') {
+            lo = parse_escape(parser, set);
+        } else {
+            lo = (unsigned char)c;
+            CharSet_add(set, lo);
+        }
+        // A range, unless the '-' is the last thing in the class
+        if (lo != -1 && parser->at + 1 < parser->length && peek(parser) == '-'
+                && parser->pattern[parser->at + 1] != ']') {
+            parser->at++;
+            int hi;
+            c = parser->pattern[parser->at++];
+            if (c == '\\') {
+                struct CharSet ignored;
+                memset(&ignored, 0, sizeof(ignored));
+                hi = parse_escape(parser, &ignored);
+            } else {
+                hi = (unsigned char)c;
+            }
+            if (hi == -1 || hi < lo) {
+                fail(parser, "bad range in character class");
+                return;
+            }
+            CharSet_add_range(set, lo, hi);
+        }
+    }
+    if (at_end(parser)) {
+        fail(parser, "missing ]");
+        return;
+    }
+    parser->at++;   // The ']'
+    if (negated) {
+        CharSet_invert(set);
+    }
+}
+
+static void parse_alternation(struct Parser* parser, struct Fragment* out);
+
+// atom := literal | '.' | '\' escape | '[' class ']' | '(' alternation ')'
+static void parse_atom(struct Parser* parser, struct Fragment* out) {
+    struct CharSet set;
+    memset(&set, 0, sizeof(set));
+    char c = parser->pattern[parser->at++];
+    switch (c) {
+        case '(':
+            parse_alternation(parser, out);
+            if (at_end(parser) || peek(parser) != ')') {
+                fail(parser, "missing )");
+                return;
+            }
+            parser->at++;
+            return;
+        case '.':
+            CharSet_add(&set, '\n');
+            CharSet_invert(&set);
+            break;
+        case '[':
+            parse_class(parser, &set);
+            break;
+        case '\\':
+            parse_escape(parser, &set);
+            break;
+        case '^':
+        case '$':
+            parser->at--;
+            fail(parser, "anchors are only supported at the start and end of the pattern");
+            break;
+        case '*':
+        case '+':
+        case '?':
+            parser->at--;
+            fail(parser, "nothing to repeat");
+            break;
+        default:
+            CharSet_add(&set, (unsigned char)c);
+            break;
+    }
+    position(parser, &set, out);
+}
+
+// repeat := atom ('*' | '+' | '?')*
+static void parse_repeat(struct Parser* parser, struct Fragment* out) {
+    parse_atom(parser, out);
+    while (!at_end(parser) && parser->error == NULL) {
+        char c = peek(parser);
+        if (c != '*' && c != '+' && c != '?') {
+            break;
+        }
+        parser->at++;
+        if (c != '?') {
+            follow(parser, &out->last, &out->first);    // Go round again
+        }
+        if (c != '+') {
+            out->nullable = true;
+        }
+    }
+}
+
+// concatenation := repeat*
+static void parse_concatenation(struct Parser* parser, struct Fragment* out) {
+    memset(out, 0, sizeof(*out));
+    out->nullable = true;
+    while (!at_end(parser) && peek(parser) != '|' && peek(parser) != ')' && parser->error == NULL) {
+        struct Fragment next;
+        parse_repeat(parser, &next);
+        follow(parser, &out->last, &next.first);
+        if (out->nullable) {
+            Positions_add_all(&out->first, &next.first);
+        }
+        if (!next.nullable) {
+            out->last.count = 0;
+        }
+        Positions_add_all(&out->last, &next.last);
+        out->nullable = out->nullable && next.nullable;
+        Fragment_free(&next);
+    }
+}
+
+// alternation := concatenation ('|' concatenation)*
+static void parse_alternation(struct Parser* parser, struct Fragment* out) {
+    parse_concatenation(parser, out);
+    while (!at_end(parser) && peek(parser) == '|' && parser->error == NULL) {
+        parser->at++;
+        struct Fragment next;
+        parse_concatenation(parser, &next);
+        Positions_add_all(&out->first, &next.first);
+        Positions_add_all(&out->last, &next.last);
+        out->nullable = out->nullable || next.nullable;
+        Fragment_free(&next);
+    }
+}
+
+// Add edges from src to dst on every byte in the given set, using a single
+// edge where the set is all or all but one of the bytes
+static void add_transitions(NFA nfa, int src, const struct CharSet* set, int dst) {
+    int count = 0;
+    int missing = 0;
+    for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+        if (CharSet_has(set, sym)) {
+            count++;
+        } else {
+            missing = sym;
+        }
+    }
+    if (count == NFA_ALPHABET_SIZE) {
+        NFA_add_transition_all(nfa, src, dst);
+    } else if (count == NFA_ALPHABET_SIZE - 1) {
+        NFA_add_transition_all_but(nfa, src, (char)missing, dst);
+    } else {
+        for (int sym = 0; sym < NFA_ALPHABET_SIZE; sym++) {
+            if (CharSet_has(set, sym)) {
+                NFA_add_transition(nfa, src, (char)sym, dst);
+            }
+        }
+    }
+}
+
+NFA* NFA_for_regex(const char* pattern) {
+    struct Parser parser;
+    parser.pattern = pattern;
+    parser.length = strlen(pattern);
+    parser.at = 0;
+    parser.error = NULL;
+    parser.capacity = 16;
+    parser.sets = (struct CharSet*)malloc(parser.capacity * sizeof(struct CharSet));
+    parser.positions = 0;
+    memset(&parser.follows, 0, sizeof(parser.follows));
+
+    // Anchors are taken off the ends before parsing (a '$' only counts if
+    // it isn't escaped, i.e. it follows an even number of backslashes)
+    bool anchoredStart = parser.length > 0 && pattern[0] == '^';
+    if (anchoredStart) {
+        parser.at = 1;
+    }
+    bool anchoredEnd = false;
+    if (parser.length > parser.at && pattern[parser.length - 1] == '$') {
+        size_t backslashes = 0;
+        while (parser.length - 1 - backslashes > parser.at && pattern[parser.length - 2 - backslashes] == '\\') {
+            backslashes++;
+        }
+        if (backslashes % 2 == 0) {
+            anchoredEnd = true;
+            parser.length -= 1;
+        }
+    }
+
+    struct Fragment regex;
+    parse_alternation(&parser, &regex);
+    if (parser.error == NULL && !at_end(&parser)) {
+        fail(&parser, "unmatched )");
+    }
+    if (parser.error != NULL) {
+        fprintf(stderr, "regex \"%s\": %s at offset %zu\n", pattern, parser.error, parser.errorAt);
+        Fragment_free(&regex);
+        free(parser.sets);
+        free(parser.follows.items);
+        return NULL;
+    }
+
+    // State 0 is the initial state and state p is position p. Without $,
+    // one more state takes over once a match has ended, accepting whatever
+    // follows it.
+    int done = parser.positions + 1;
+    NFA* nfa = (NFA*)malloc(sizeof(NFA));
+    *nfa = new_NFA(anchoredEnd ? done : done + 1);
+    if (!anchoredStart) {
+        NFA_add_transition_all(*nfa, 0, 0);
+    }
+    for (int i = 0; i < regex.first.count; i++) {
+        int p = regex.first.items[i];
+        add_transitions(*nfa, 0, &parser.sets[p], p);
+    }
+    for (int i = 0; i < parser.follows.count; i += 2) {
+        int p = parser.follows.items[i];
+        int q = parser.follows.items[i + 1];
+        add_transitions(*nfa, p, &parser.sets[q], q);
+    }
+    for (int i = 0; i < regex.last.count; i++) {
+        NFA_set_accepting(*nfa, regex.last.items[i], true);
+    }
+    if (regex.nullable) {
+        NFA_set_accepting(*nfa, 0, true);
+    }
+    if (!anchoredEnd) {
+        NFA_set_accepting(*nfa, done, true);
+        NFA_add_transition_all(*nfa, done, done);
+        for (int i = 0; i < regex.last.count; i++) {
+            NFA_add_transition_all(*nfa, regex.last.items[i], done);
+        }
+        if (regex.nullable) {
+            NFA_add_transition_all(*nfa, 0, done);
+        }
+    }
+
+    Fragment_free(&regex);
+    free(parser.sets);
+    free(parser.follows.items);
+    return nfa;
+}
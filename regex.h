@@ -0,0 +1,36 @@
+//
+// File: regex.h
+// Created: 10/17/2026
+//
+
+#ifndef REGEX_H
+#define REGEX_H
+
+#include "nfa.h"
+
+/**
+ * Compile the given regular expression into a new NFA and return it, or
+ * return NULL (after printing an error message) if the pattern is not
+ * valid. The NFA is built with Glushkov's construction, so it has one
+ * state per character (or class) in the pattern, plus an initial state,
+ * and no epsilon transitions.
+ *
+ * Supported syntax, over bytes:
+ *  - Literal characters, and \ before any special character
+ *  - .        any byte except newline
+ *  - [abc] [a-z] [^...]   character classes (\d \w \s work inside them too)
+ *  - \d \w \s \D \W \S    digits, word characters, white space, and their
+ *                         complements
+ *  - \n \t \r \f \v \xHH  control characters and bytes by hex value
+ *  - ( )      grouping
+ *  - |        alternation
+ *  - * + ?    zero or more, one or more, zero or one of what precedes them
+ *  - ^ $      at the very start and end of the pattern only: anchors
+ *
+ * As with the other NFAs, the whole input is accepted or rejected. Without
+ * ^ the match may start anywhere in the input, and without $ anything may
+ * follow it, so by default the NFA accepts input that contains a match.
+ */
+extern NFA* NFA_for_regex(const char* pattern);
+
+#endif //REGEX_H
@@ -0,0 +1,178 @@
+//
+// File: scan.c
+// Created: 10/17/2026
+//
+// Running a DFA over whole files. Files are memory-mapped rather than read,
+// so the DFA walks the page cache directly with no copying.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scan.h"
+#include "parallel.h"
+
+size_t DFA_scan_matches(DFA dfa, const uint8_t* data, size_t length,
+                        void (*report)(size_t offset, void* ctx), void* ctx) {
+    size_t count = 0;
+    int state = DFA_get_initialState(dfa);
+    size_t offset = 0;
+    while (offset < length) {
+        offset += DFA_advance_to_accept(dfa, &state, data + offset, length - offset);
+        if (state == -1 || !DFA_get_accepting(dfa, state)) {
+            break;
+        }
+        report(offset, ctx);
+        count += 1;
+        if (DFA_is_absorbing(dfa, state)) {
+            break;
+        }
+    }
+    return count;
+}
+
+size_t DFA_scan_lines(DFA dfa, const uint8_t* data, size_t length,
+                      void (*report)(size_t line, bool accepted, void* ctx), void* ctx) {
+    size_t count = 0;
+    size_t line = 0;
+    size_t start = 0;
+    while (start < length) {
+        const uint8_t* newline = memchr(data + start, '\n', length - start);
+        size_t end = newline == NULL ? length : (size_t)(newline - data);
+        bool accepted = DFA_execute_buf(dfa, data + start, end - start);
+        line += 1;
+        count += accepted;
+        report(line, accepted, ctx);
+        start = end + 1;
+    }
+    return count;
+}
+
+static void print_offset(size_t offset, void* ctx) {
+    fprintf((FILE*)ctx, "%zu\n", offset);
+}
+
+static void print_line(size_t line, bool accepted, void* ctx) {
+    fprintf((FILE*)ctx, "%zu %s\n", line, accepted ? "accept" : "reject");
+}
+
+static bool print_match(Match match, void* ctx) {
+    fprintf((FILE*)ctx, "%zu %zu\n", match.start, match.end);
+    return true;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Memory-map the named file read-only for one sequential pass. Stores its
+// length in *length and returns the mapping (NULL for an empty file), or
+// prints an error message and returns MAP_FAILED.
+static const uint8_t* map_file(const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return MAP_FAILED;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return MAP_FAILED;
+    }
+    *length = (size_t)st.st_size;
+    void* map = NULL;
+    if (*length > 0) {
+        map = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        } else {
+            posix_madvise(map, *length, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    return (const uint8_t*)map;
+}
+
+static void unmap_file(const uint8_t* data, size_t length) {
+    if (length > 0) {
+        munmap((void*)data, length);
+    }
+}
+
+// Print how long it took to get through length bytes of the named file
+static void report_throughput(const char* path, size_t length, double seconds, const char* result) {
+    fprintf(stderr, "%s: %zu bytes, %s in %.3f s (%.1f MB/s)\n", path, length, result, seconds,
+            seconds > 0 ? length / seconds / 1e6 : 0.0);
+}
+
+int DFA_scan_file(DFA dfa, const char* path, bool perLine, FILE* out) {
+    size_t length;
+    const uint8_t* data = map_file(path, &length);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    double start = now();
+    size_t count;
+    if (perLine) {
+        count = DFA_scan_lines(dfa, data, length, print_line, out);
+    } else {
+        count = DFA_scan_matches(dfa, data, length, print_offset, out);
+    }
+    fflush(out);
+    double seconds = now() - start;
+
+    char result[64];
+    snprintf(result, sizeof(result), "%zu %s", count, perLine ? "lines accepted" : "matches");
+    report_throughput(path, length, seconds, result);
+    unmap_file(data, length);
+    return 0;
+}
+
+int DFA_match_file(DFA dfa, const char* path, int nthreads, FILE* out) {
+    size_t length;
+    const uint8_t* data = map_file(path, &length);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    double start = now();
+    bool accepted = DFA_execute_parallel(dfa, data, length, nthreads);
+    double seconds = now() - start;
+
+    fprintf(out, "%s\n", accepted ? "accept" : "reject");
+    fflush(out);
+    report_throughput(path, length, seconds, accepted ? "accepted" : "rejected");
+    unmap_file(data, length);
+    return 0;
+}
+
+int DFA_find_file(DFA dfa, const char* path, FILE* out) {
+    size_t length;
+    const uint8_t* data = map_file(path, &length);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    double start = now();
+    size_t count = DFA_find_all(dfa, data, length, print_match, out);
+    fflush(out);
+    double seconds = now() - start;
+
+    char result[64];
+    snprintf(result, sizeof(result), "%zu matches", count);
+    report_throughput(path, length, seconds, result);
+    unmap_file(data, length);
+    return 0;
+}
@@ -0,0 +1,61 @@
+//
+// File: scan.h
+// Created: 10/17/2026
+//
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "dfa.h"
+
+/**
+ * Run the given DFA once over the whole buffer and call report with the end
+ * offset of every prefix it accepts: after reading byte i, if the DFA is in
+ * an accepting state, report(i + 1, ctx) is called. For "contains"-style
+ * automata that is the end of every match. Scanning stops early at the
+ * reject state, and after reporting a match in an accepting state that
+ * loops to itself on every input (every later offset would match too).
+ * Returns the number of offsets reported.
+ */
+extern size_t DFA_scan_matches(DFA dfa, const uint8_t* data, size_t length,
+                               void (*report)(size_t offset, void* ctx), void* ctx);
+
+/**
+ * Run the given DFA separately over each newline-terminated line of the
+ * buffer (the newline itself is not part of the line, and a final line
+ * without one still counts) and call report with the line number (from 1)
+ * and whether the line was accepted. Returns the number of accepted lines.
+ */
+extern size_t DFA_scan_lines(DFA dfa, const uint8_t* data, size_t length,
+                             void (*report)(size_t line, bool accepted, void* ctx), void* ctx);
+
+/**
+ * Memory-map the named file and scan it with the given DFA, writing to out
+ * either every match end offset (one per line) or, if perLine is true,
+ * "<line number> accept|reject" for each line. The throughput in MB/s is
+ * printed to stderr at the end. Returns 0 on success, or -1 (after printing
+ * an error message) if the file can't be read.
+ */
+extern int DFA_scan_file(DFA dfa, const char* path, bool perLine, FILE* out);
+
+/**
+ * Memory-map the named file and run the given DFA over its whole contents
+ * with DFA_execute_parallel on nthreads threads, writing "accept" or
+ * "reject" to out and the throughput to stderr. Returns 0 on success, or
+ * -1 (after printing an error message) if the file can't be read.
+ */
+extern int DFA_match_file(DFA dfa, const char* path, int nthreads, FILE* out);
+
+/**
+ * Memory-map the named file and write "<start> <end>" to out for each of
+ * the non-overlapping leftmost-longest matches of the given DFA in it (see
+ * DFA_find_all), and the throughput to stderr. Returns 0 on success, or -1
+ * (after printing an error message) if the file can't be read.
+ */
+extern int DFA_find_file(DFA dfa, const char* path, FILE* out);
+
+#endif //SCAN_H
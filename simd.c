@@ -0,0 +1,110 @@
+//
+// File: simd.c
+// Created: 10/17/2026
+//
+// Vector-instruction execution for tiny DFAs. With at most 16 states, a
+// whole column of the transition table fits in one 16-byte register, and
+// the x86 pshufb instruction looks up the next state in it in one cycle,
+// instead of waiting on a load from the table for every input byte. The
+// SSSE3 code is compiled for that instruction set on its own (with a
+// target attribute) and only run when the CPU reports that it has it, so
+// the rest of the program needs no special compiler flags.
+//
+// The byte search that lets automata skip over uninteresting input compares
+// 16 bytes at a time with SSE2, which every x86-64 CPU has.
+//
+
+#include <string.h>
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Bytes run between checks for the dead state
+#define SIMD_CHECK_INTERVAL 64
+
+#ifdef SIMD_SSSE3
+
+bool SIMD_shuffle_supported(void) {
+    return __builtin_cpu_supports("ssse3");
+}
+
+__attribute__((target("ssse3")))
+int SIMD_shuffle_advance(const uint8_t* vectors, const uint8_t* classes, int state, int dead,
+                         const uint8_t* input, size_t length) {
+    // Every byte of the register holds the current state, so every byte of
+    // the shuffle's result holds the next one
+    __m128i current = _mm_set1_epi8((char)state);
+    size_t i = 0;
+    while (i < length) {
+        size_t end = length - i > SIMD_CHECK_INTERVAL ? i + SIMD_CHECK_INTERVAL : length;
+        for (; i < end; i++) {
+            __m128i column = _mm_loadu_si128((const __m128i*)(vectors + 16 * classes[input[i]]));
+            current = _mm_shuffle_epi8(column, current);
+        }
+        if ((_mm_cvtsi128_si32(current) & 0xFF) == dead) {
+            break;
+        }
+    }
+    return _mm_cvtsi128_si32(current) & 0xFF;
+}
+
+#else
+
+bool SIMD_shuffle_supported(void) {
+    return false;
+}
+
+// Portable version of the same thing, for builds without SSSE3 support
+int SIMD_shuffle_advance(const uint8_t* vectors, const uint8_t* classes, int state, int dead,
+                         const uint8_t* input, size_t length) {
+    for (size_t i = 0; i < length && state != dead; i++) {
+        state = vectors[16 * classes[input[i]] + state];
+    }
+    return state;
+}
+
+#endif
+
+size_t SIMD_find_any(const uint8_t* bytes, int n, const uint8_t* input, size_t length) {
+    if (n == 0) {
+        return length;
+    }
+    if (n == 1) {
+        // The C library's memchr is already as vectorized as it gets
+        const uint8_t* found = memchr(input, bytes[0], length);
+        return found == NULL ? length : (size_t)(found - input);
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i wanted[SIMD_FIND_MAX];
+    for (int k = 0; k < n; k++) {
+        wanted[k] = _mm_set1_epi8((char)bytes[k]);
+    }
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(input + i));
+        __m128i hits = _mm_cmpeq_epi8(block, wanted[0]);
+        for (int k = 1; k < n; k++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, wanted[k]));
+        }
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        for (int k = 0; k < n; k++) {
+            if (input[i] == bytes[k]) {
+                return i;
+            }
+        }
+    }
+    return length;
+}
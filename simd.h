@@ -0,0 +1,61 @@
+//
+// File: simd.h
+// Created: 10/17/2026
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The most states (counting the reject state, if it can be reached) that
+ * SIMD_shuffle_advance can handle.
+ */
+#define SIMD_SHUFFLE_STATES 16
+
+/**
+ * Return true if this machine can run SIMD_shuffle_advance (an x86 CPU
+ * with SSSE3).
+ */
+extern bool SIMD_shuffle_supported(void);
+
+/**
+ * Run a DFA of at most SIMD_SHUFFLE_STATES states over length bytes of
+ * input, starting from the given state, and return the state it ends in.
+ * vectors holds 16 bytes per input class: byte s of vector c is the state
+ * reached from state s on class c, so a step is a single byte shuffle
+ * (pshufb) of the class's vector by the current state. classes maps input
+ * bytes to classes. If dead isn't -1 it is a state that can't be left,
+ * and the run stops early once it gets there.
+ * Only call this if SIMD_shuffle_supported() returns true.
+ */
+extern int SIMD_shuffle_advance(const uint8_t* vectors, const uint8_t* classes, int state, int dead,
+                                const uint8_t* input, size_t length);
+
+/**
+ * The most distinct bytes SIMD_find_any can look for.
+ */
+#define SIMD_FIND_MAX 4
+
+/**
+ * Return the index of the first byte of input that is one of the n
+ * (at most SIMD_FIND_MAX) given bytes, or length if there is none. With
+ * n == 0 that is always length. Used to skip over input that leaves a DFA
+ * or NFA where it is, 16 bytes at a time.
+ */
+extern size_t SIMD_find_any(const uint8_t* bytes, int n, const uint8_t* input, size_t length);
+
+/**
+ * How automata decide whether skipping with SIMD_find_any is paying off: a
+ * skip of less than SIMD_SKIP_MIN bytes hardly does, and after
+ * SIMD_SKIP_MISSES of those in a row they stop skipping for the next
+ * SIMD_SKIP_BACKOFF bytes.
+ */
+#define SIMD_SKIP_MIN 16
+#define SIMD_SKIP_MISSES 8
+#define SIMD_SKIP_BACKOFF 4096
+
+#endif //SIMD_H
@@ -6,204 +6,213 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "translate.h"
 #include "dfa.h"
 #include "nfa.h"
+#include "SubsetMap.h"
 
-int findIndex(IntHashSet* set, int size, IntHashSet want) {
-    for (int i = 0; i < size; i++) {
-        if (IntHashSet_equals(want, set[i])) {
-            return i;
+#if NFA_ALPHABET_SIZE != DFA_ALPHABET_SIZE
+# error "NFA and DFA alphabets must be the same size"
+#endif
+
+// Compare function for sorting state ids with qsort
+static int compare_states(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Store the elements of the given set (which is freed) in sorted order in key
+// (the canonical form used by the SubsetMap) and return how many there are.
+static int subset_key(Set set, int* key) {
+    int n = 0;
+    SetIterator iterator = Set_iterator(set);
+    while (SetIterator_hasNext(iterator)) {
+        key[n++] = SetIterator_next(iterator);
+    }
+    free(iterator);
+    Set_free(set);
+    qsort(key, n, sizeof(int), compare_states);
+    return n;
+}
+
+// Store the initial state of the given NFA and its epsilon closure, sorted, in
+// states, and return how many there are.
+int NFA_initial_subset(NFA nfa, int* states) {
+    Set initialStates = new_Set(NFA_get_size(nfa));
+    NFA_union_closure(nfa, NFA_get_initialState(nfa), initialStates);
+    return subset_key(initialStates, states);
+}
+
+// Store the subset the n given NFA states lead to on the given symbol, sorted,
+// in next, and return how many states are in it.
+int NFA_subset_step(NFA nfa, const int* states, int n, char sym, int* next) {
+    Set nextStates = new_Set(NFA_get_size(nfa));
+    for (int i = 0; i < n; i++) {
+        NFA_union_transitions(nfa, states[i], sym, nextStates);
+    }
+    return subset_key(nextStates, next);
+}
+
+// Return true if any NFA state in the given subset is accepting
+bool NFA_subset_accepting(NFA nfa, const int* states, int n) {
+    for (int i = 0; i < n; i++) {
+        if (NFA_get_accepting(nfa, states[i])) {
+            return true;
         }
     }
-    return -1;
+    return false;
 }
 
-DFA* NFA_to_DFA(NFA* nfa) {
-    // DFA of size 2^n
-    DFA* dfa = malloc(sizeof(DFA));
+// Subset construction. Only the subsets reachable from the initial state are
+// ever materialized: DFA state i stands for subset i of the SubsetMap, and
+// states are numbered in the order they are discovered, so every id at or
+// past i is still waiting on the worklist. If visit is not NULL it is called
+// with each new DFA state and its subset.
+DFA* NFA_to_DFA_visit(NFA* nfa, SubsetVisitor visit, void* ctx) {
+    clock_t start = clock();
     int size = NFA_get_size(*nfa);
-    *dfa = new_DFA(1 << size);
-
-    // IntHashSet of all the subsets created, which is also 2^n
-    IntHashSet* subsets = (IntHashSet*)malloc((1 << size) * sizeof(IntHashSet));
-    for (int i = 0; i < (1 << size); i++) {
-        subsets[i] = new_IntHashSet(size);
-        for (int j = 0; j < size; j++) {
-            if (((1 << j) & i) == 0) {
-                IntHashSet_insert(subsets[i], j);
-                if (IntHashSet_lookup(*subsets, i)){
-                    DFA_set_accepting(*dfa, i+j, true);
-                }
-            }
-        }
+
+    // Symbols in the same class always lead to the same subset, so each
+    // subset only needs to be expanded once per class
+    unsigned char classes[NFA_ALPHABET_SIZE];
+    int nclasses = NFA_get_classes(*nfa, classes);
+    char representative[NFA_ALPHABET_SIZE];
+    for (int sym = NFA_ALPHABET_SIZE - 1; sym >= 0; sym--) {
+        representative[classes[sym]] = (char)sym;
+    }
+
+    DFA* dfa = malloc(sizeof(DFA));
+    *dfa = new_DFA_classes(1, classes, nclasses);
+
+    SubsetMap subsets = new_SubsetMap(size);
+    int* key = (int*)malloc(size * sizeof(int));
+    int* current = (int*)malloc(size * sizeof(int));
+    int initialSize = NFA_initial_subset(*nfa, key);
+    SubsetMap_intern(subsets, key, initialSize, NULL);
+    DFA_set_initialState(*dfa, 0);
+    DFA_set_accepting(*dfa, 0, NFA_subset_accepting(*nfa, key, initialSize));
+    if (visit != NULL) {
+        visit(*dfa, 0, key, initialSize, ctx);
     }
 
-    IntHashSet currStates = new_IntHashSet(1 << size);      // IntHashSet of current states
-    IntHashSet_insert(currStates, 0);                     // Add initial state 0 to current state
-    for (int i = 0; i < (1 << size); i++) {                      // For each subset
-        for (int j = 0; j < 128; j++) {                          // For all inputs
-            IntHashSet nextStates = new_IntHashSet(1 << size);           // Store next states based on transitions
-            IntHashSetIterator iterator = IntHashSet_iterator(subsets[i]); // For each element in the subset
-            while (IntHashSetIterator_hasNext(iterator)) {                  // Get all possible transitions
-                int element = IntHashSetIterator_next(iterator);
-                IntHashSet transitions = NFA_get_transitions(*nfa, element, (char) j);
-                IntHashSet_union(nextStates, transitions);
+    for (int i = 0; i < SubsetMap_count(subsets); i++) {       // For each unprocessed subset
+        int n;
+        const int* states = SubsetMap_get(subsets, i, &n);
+        memcpy(current, states, n * sizeof(int));               // Interning below may move the pool
+        for (int j = 0; j < nclasses; j++) {                    // For all input classes
+            int m = NFA_subset_step(*nfa, current, n, representative[j], key);
+            if (m == 0) {                                       // Empty subset is the reject state
+                continue;
             }
-            if(!IntHashSet_isEmpty(nextStates) && (!getTest(*nfa))){
-                int index = findIndex(subsets, 1<<size, nextStates); // Create dfa transitions
-                DFA_set_transition(*dfa, i, (char)j, index);
+            bool added;
+            int index = SubsetMap_intern(subsets, key, m, &added);
+            if (added) {                                        // New subset: add it to the worklist
+                DFA_add_state(*dfa);
+                DFA_set_accepting(*dfa, index, NFA_subset_accepting(*nfa, key, m));
+                if (visit != NULL) {
+                    visit(*dfa, index, key, m, ctx);
+                }
             }
-            IntHashSet_free(currStates);
-            currStates = nextStates;
-            free(iterator);
+            DFA_set_class_transition(*dfa, i, j, index);
         }
     }
 
-    // Free memory
-    for (int i = 0; i < (1 << size); i++) {
-        IntHashSet_free(subsets[i]);
-    }
-    free(subsets);
+    DFA_compress(*dfa);
 
     // Done!!
-    printf("Number of states in the DFA: %d\n", DFA_get_size(*dfa));
-
-    // ---------------------------------------------------------------------------------------------
-
-    // REMOVE THIS LATER ignore testing stuff below
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 0, (char)j));
-    //    }
-
-    //    for (int i = 0; i < (1 << size); i++) {
-    //        printf("\n%i: ", i);
-    //        IntHashSet_print(subsets[i]);
-    //    }
-
-    // testing transitions states for each input
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 1, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 2, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 3, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 4, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 5, (char)j));
-    //    }
+    double elapsed = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+    // Reported on stderr so that it stays out of scan output
+    fprintf(stderr, "Number of states in the DFA: %d reachable, %d input classes (built in %.3f ms)\n",
+            DFA_get_size(*dfa), DFA_get_num_classes(*dfa), elapsed);
+    SubsetMap_print_stats(subsets, stderr);
 
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 6, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 7, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 8, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 9, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 10, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 11, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 12, (char)j));
-    //    }
-
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 13, (char)j));
-    //    }
+    // Free memory
+    SubsetMap_free(subsets);
+    free(key);
+    free(current);
 
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 14, (char)j));
-    //    }
+    return (DFA*) dfa;
+}
 
-    //    for (int j = 0; j < 128; j++){
-    //        printf("\nFor %c: %i", (char)j, DFA_get_transition(*dfa, 15, (char)j));
-    //    }
+DFA* NFA_to_DFA(NFA* nfa) {
+    return NFA_to_DFA_visit(nfa, NULL, NULL);
+}
 
-    if (getTest(*nfa)){
-        for(int i = 0; i < size; i++){
-            DFA_set_accepting(*dfa, i, false);
+// What tag_patterns needs to know about the NFAs combined by NFA_union_to_DFA
+struct PatternTags {
+    NFA* nfas;
+    int count;
+    int* offsets;       // Where each pattern's states start in the union
+    int* ids;           // Scratch: pattern ids of the current subset
+    bool* seen;         // Scratch: which of them have been added
+};
+
+// Return the pattern that the given state of the union NFA came from
+static int pattern_of(const struct PatternTags* tags, int state) {
+    int lo = 0;
+    int hi = tags->count - 1;
+    while (lo < hi) {                   // Last pattern starting at or before state
+        int mid = (lo + hi + 1) / 2;
+        if (tags->offsets[mid] <= state) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
         }
-        DFA_set_accepting(*dfa, 3, true);
-        DFA_set_accepting(*dfa, 4, true);
-        DFA_set_accepting(*dfa, 5, true);
-        DFA_set_accepting(*dfa, 6, true);
+    }
+    return lo;
+}
 
-        int a = 'a';
-        int t = 't';
-        int h = 'h';
+// Add pattern k to the ids of the current subset, unless it is already there
+static void add_pattern(struct PatternTags* tags, int k, int* count) {
+    if (!tags->seen[k]) {
+        tags->seen[k] = true;
+        tags->ids[(*count)++] = k;
+    }
+}
 
-        for (int z = 0; z < 128; z++){
-            DFA_set_transition(*dfa, 6, (char)z, 6);
-        }
-        DFA_set_transition(*dfa, 5, 'a', 4);
-        DFA_set_transition(*dfa, 5, 't', 3);
-        DFA_set_transition(*dfa, 5, 'h', 3);
-        for (int z = 0; z < 128; z++){
-            if((z!=a) && (z!=t) && (z!=h)){
-                DFA_set_transition(*dfa, 5, (char)z, 6);
-            }
-        }
-        DFA_set_transition(*dfa, 4, 'a', 4);
-        DFA_set_transition(*dfa, 4, 't', 5);
-        DFA_set_transition(*dfa, 4, 'h', 3);
-        for (int y = 0; y < 128; y++){
-            if((y!=a) && (y!=t) && (y!=h)){
-                DFA_set_transition(*dfa, 4, (char)y, 6);
-            }
-        }
-        DFA_set_transition(*dfa, 3, 'a', 4);
-        DFA_set_transition(*dfa, 3, 't', 3);
-        DFA_set_transition(*dfa, 3, 'h', 3);
-        for (int x = 0; x < 128; x++){
-            if((x!=a) && (x!=t) && (x!=h)){
-                DFA_set_transition(*dfa, 3, (char)x, 6);
-            }
-        }
-        DFA_set_transition(*dfa, 2, 'a', 1);
-        DFA_set_transition(*dfa, 2, 'h', 3);
-        for (int w = 0; w < 128; w++){
-            if((w!=a) && (w!=h)){
-                DFA_set_transition(*dfa, 2, (char)w, 0);
-            }
-        }
-        DFA_set_transition(*dfa, 1, 'a', 1);
-        DFA_set_transition(*dfa, 1, 't', 2);
-        for (int v = 0; v < 128; v++){
-            if((v!=a) && (v!=t)){
-                DFA_set_transition(*dfa, 1, (char)v, 0);
+// Tag a new DFA state with the patterns that have an accepting state in its subset
+static void tag_patterns(DFA dfa, int state, const int* subset, int n, void* ctx) {
+    struct PatternTags* tags = (struct PatternTags*)ctx;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (subset[i] == 0) {
+            // The union's initial state stands for every pattern's initial state
+            for (int k = 0; k < tags->count; k++) {
+                if (NFA_get_accepting(tags->nfas[k], NFA_get_initialState(tags->nfas[k]))) {
+                    add_pattern(tags, k, &count);
+                }
             }
-        }
-        DFA_set_transition(*dfa, 0, 'a', 1);
-        for (int u = 0; u < 128; u++){
-            if((u!=a)){
-                DFA_set_transition(*dfa, 0, (char)u, 0);
+        } else {
+            int k = pattern_of(tags, subset[i]);
+            if (NFA_get_accepting(tags->nfas[k], subset[i] - tags->offsets[k])) {
+                add_pattern(tags, k, &count);
             }
         }
     }
+    qsort(tags->ids, count, sizeof(int), compare_states);
+    for (int i = 0; i < count; i++) {
+        tags->seen[tags->ids[i]] = false;
+    }
+    DFA_set_patterns(dfa, state, tags->ids, count);
+}
 
-    return (DFA*) dfa;
-}
\ No newline at end of file
+// Combine the given NFAs into one with NFA_union and convert that, tagging
+// every DFA state with the ids (indices in nfas) of the patterns it matches.
+DFA* NFA_union_to_DFA(NFA* nfas, int count) {
+    struct PatternTags tags;
+    tags.nfas = nfas;
+    tags.count = count;
+    tags.offsets = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    tags.ids = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    tags.seen = (bool*)calloc(count > 0 ? count : 1, sizeof(bool));
+    NFA nfa = NFA_union(nfas, count, tags.offsets);
+    DFA* dfa = NFA_to_DFA_visit(&nfa, tag_patterns, &tags);
+    NFA_free(nfa);
+    free(tags.offsets);
+    free(tags.ids);
+    free(tags.seen);
+    return dfa;
+}
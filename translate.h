@@ -11,8 +11,43 @@
 #include "dfa.h"
 #include "nfa.h"
 
-extern int findIndex(IntHashSet* set, int size, IntHashSet want);
-
 extern DFA* NFA_to_DFA(NFA* nfa);
 
+/**
+ * The steps of the subset construction, shared by NFA_to_DFA and the
+ * LazyDFA. Subsets are arrays of NFA states in increasing order, and the
+ * arrays filled in must have room for every state of the NFA.
+ *
+ * NFA_initial_subset stores the NFA's initial subset (its initial state and
+ * the states reachable from it by epsilon transitions) in states and returns
+ * its size. NFA_subset_step stores the subset that the n states in states
+ * lead to on input symbol sym in next and returns its size (0 for the reject
+ * state). NFA_subset_accepting returns true if any of the n states in states
+ * is accepting.
+ */
+extern int NFA_initial_subset(NFA nfa, int* states);
+extern int NFA_subset_step(NFA nfa, const int* states, int n, char sym, int* next);
+extern bool NFA_subset_accepting(NFA nfa, const int* states, int n);
+
+/**
+ * Called by NFA_to_DFA_visit for each new DFA state, with the n sorted NFA
+ * states of the subset it stands for.
+ */
+typedef void (*SubsetVisitor)(DFA dfa, int state, const int* subset, int n, void* ctx);
+
+/**
+ * Like NFA_to_DFA, but call visit(dfa, state, subset, n, ctx) as each state
+ * is created, e.g. to attach information about its NFA states.
+ */
+extern DFA* NFA_to_DFA_visit(NFA* nfa, SubsetVisitor visit, void* ctx);
+
+/**
+ * Convert the union of the count given NFAs (see NFA_union) into one DFA,
+ * and tag each of its states with the ids of the patterns it matches, a
+ * pattern's id being its index in nfas (see DFA_get_patterns). Running the
+ * DFA once with DFA_execute_patterns then tells which of the NFAs accept
+ * the input, in time that doesn't depend on how many there are.
+ */
+extern DFA* NFA_union_to_DFA(NFA* nfas, int count);
+
 #endif //TRANSLATE_H